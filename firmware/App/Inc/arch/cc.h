@@ -1,4 +1,14 @@
 #ifndef __CC_H
 #define __CC_H
 
+#include "logger.h"
+#include <stdlib.h>
+
+/* failed assertions go out as a log event, not through printf */
+#define LWIP_PLATFORM_ASSERT(x)                                                                  \
+    do {                                                                                         \
+        LOG_EVENT1(LOG_EV_LWIP_ASSERT, "lwIP assertion \"" x "\" failed at line %lu", __LINE__); \
+        abort();                                                                                 \
+    } while (0)
+
 #endif /* __CC_H */
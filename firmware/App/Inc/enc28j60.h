@@ -17,16 +17,53 @@
 #define ENC28J60_MINFRAME 64
 #define ENC28J60_MAXFRAME 1600 /* 600 */
 
+/*
+ * Buffer transfers shorter than this are polled, longer ones go through DMA
+ */
+
+#define ENC28J60_DMA_MINLEN 16
+
+/*
+ * Rx mode: 1 = wait for INT line (PA8), 0 = poll EPKTCNT on every call
+ */
+
+#define ENC28J60_RX_IRQ 1
+
 /*
  * Buffer size
  */
 
 #define ENC28J60_BUFSIZE 0x2000
 #define ENC28J60_BUFEND  (ENC28J60_BUFSIZE - 1)
-#define ENC28J60_RXSIZE  0x1A00
+#define ENC28J60_RXSIZE  0x1400
 #define ENC28J60_RXSTART 0
 #define ENC28J60_RXEND   (ENC28J60_RXSIZE - 1)
 #define ENC28J60_TXSTART (ENC28J60_RXSIZE)
+#define ENC28J60_TXSIZE  (ENC28J60_BUFSIZE - ENC28J60_RXSIZE)
+
+// Tx buffer holds two slots: one on the wire, one being loaded
+#define ENC28J60_TXSLOTS 2
+#define ENC28J60_TXSLOT  (ENC28J60_TXSIZE / ENC28J60_TXSLOTS)
+
+// Largest frame that fits in a Tx slot with the control byte and the status vector
+#define ENC28J60_TXMAXFRAME (ENC28J60_TXSLOT - 1 - 7)
+
+/*
+ * Tx status
+ */
+
+#define ENC28J60_TX_SENDING 0 // frame is on the wire
+#define ENC28J60_TX_QUEUED  1 // frame is loaded, it goes out when the wire is free
+#define ENC28J60_TX_BUSY    2 // no free slot, try again later
+
+/*
+ * Rx filters
+ */
+
+#define ENC28J60_FILTER_UNICAST   0x01 // frames to own MAC
+#define ENC28J60_FILTER_BROADCAST 0x02 // all broadcast frames
+#define ENC28J60_FILTER_ARP       0x04 // broadcast ARP frames only (pattern match)
+#define ENC28J60_FILTER_MULTICAST 0x08 // multicast groups in hash table
 
 /*
  * MII and MAC constant
@@ -437,13 +474,56 @@
 #define PHLCON_LFRQ0  0x0004
 #define PHLCON_STRCH  0x0002
 
+// Register op for enc28j60_program(): cmd is ENC28J60_SPI_WCR, _BFS or _BFC
+typedef struct {
+    uint8_t cmd;
+    uint8_t adr;
+    uint8_t val;
+} enc28j60_op_t;
+
+#define ENC28J60_WCR(adr, val)   {ENC28J60_SPI_WCR, (adr), (val)}
+#define ENC28J60_WCR16(adr, val) {ENC28J60_SPI_WCR, (adr), (val) & 0xFF}, {ENC28J60_SPI_WCR, (adr) + 1, (val) >> 8}
+#define ENC28J60_BFS(adr, mask)  {ENC28J60_SPI_BFS, (adr), (mask)}
+#define ENC28J60_BFC(adr, mask)  {ENC28J60_SPI_BFC, (adr), (mask)}
+
+// Driver counters, SPI transactions per frame = spi / (rx + tx)
+typedef struct {
+    uint32_t spi; // chip select cycles
+    uint32_t rx;  // received frames
+    uint32_t tx;  // sent frames
+} enc28j60_stats_t;
+
 // Init ENC28J60
 void enc28j60_init(uint8_t *macadr);
+const enc28j60_stats_t *enc28j60_get_stats(void);
 
 // Send/Reciee packets
-void enc28j60_send_packet(uint8_t *data, uint16_t len);
+uint8_t enc28j60_send_packet(uint8_t *data, uint16_t len);
 uint16_t enc28j60_recv_packet(uint8_t *buf, uint16_t buflen);
 
+// Send a packet gathered from several parts: begin, append..., commit
+// Nothing waits for the wire, call enc28j60_send_poll() to move the slots on
+uint8_t enc28j60_send_begin(void);
+void enc28j60_send_append(const uint8_t *data, uint16_t len);
+void enc28j60_send_checksum(uint16_t start, uint16_t len, uint16_t pos, uint16_t seed);
+uint8_t enc28j60_send_commit(void);
+void enc28j60_send_poll(void);
+
+// Receive a packet in parts: header, payload chunks, release
+uint16_t enc28j60_recv_begin(void);
+void enc28j60_recv_read(uint8_t *buf, uint16_t len);
+uint16_t enc28j60_recv_checksum(uint16_t start, uint16_t len);
+void enc28j60_recv_end(void);
+
+// Rx interrupt
+void enc28j60_irq(void);
+uint8_t enc28j60_rx_pending(void);
+
+// Rx filters
+void enc28j60_set_filter(uint8_t filters);
+void enc28j60_hash_add(const uint8_t *mac);
+void enc28j60_hash_remove(const uint8_t *mac);
+
 // R/W Control registers
 uint8_t enc28j60_rcr(uint8_t adr);
 uint16_t enc28j60_rcr16(uint8_t adr);
@@ -453,11 +533,20 @@ void enc28j60_bfc(uint8_t adr, uint8_t mask);
 void enc28j60_bfs(uint8_t adr, uint8_t mask);
 void enc28j60_bfc_mac_mii(uint8_t adr, uint8_t mask);
 void enc28j60_bfs_mac_mii(uint8_t adr, uint8_t mask);
+void enc28j60_program(const enc28j60_op_t *ops, uint8_t count);
 
 // R/W Rx/Tx buffers
 void enc28j60_read_buffer(uint8_t *buf, uint16_t len);
 void enc28j60_write_buffer(uint8_t *buf, uint16_t len);
 
+// R/W Rx/Tx buffers in background (SPI2 + DMA1 channel 4/5)
+// The callback runs in interrupt context, any other driver call waits for the burst
+typedef void (*enc28j60_dma_cb_t)(void);
+void enc28j60_read_buffer_dma(uint8_t *buf, uint16_t len, enc28j60_dma_cb_t cb);
+void enc28j60_write_buffer_dma(const uint8_t *buf, uint16_t len, enc28j60_dma_cb_t cb);
+uint8_t enc28j60_dma_busy(void);
+void enc28j60_dma_irq(void);
+
 // R/W PHY registers
 uint16_t enc28j60_read_phy(uint8_t adr);
 void enc28j60_write_phy(uint8_t adr, uint16_t data);
@@ -0,0 +1,137 @@
+#ifndef __LOGGER_H
+#define __LOGGER_H
+
+#include <stdint.h>
+#include <stdio.h>
+
+/*
+ * Log ring size, must be a power of 2
+ */
+
+#define LOGGER_BUFSIZE 1024
+
+/*
+ * Text log levels, anything above LOG_LEVEL is not compiled in
+ */
+
+#define LOG_LEVEL_NONE  0
+#define LOG_LEVEL_ERROR 1
+#define LOG_LEVEL_WARN  2
+#define LOG_LEVEL_INFO  3
+#define LOG_LEVEL_DEBUG 4
+
+#ifndef LOG_LEVEL
+#define LOG_LEVEL LOG_LEVEL_WARN
+#endif
+
+/*
+ * Event output: binary records for Tools/log_decoder.py, printf text, or nothing
+ */
+
+#define LOG_EVENTS_OFF    0
+#define LOG_EVENTS_BINARY 1
+#define LOG_EVENTS_TEXT   2
+
+#ifndef LOG_EVENTS
+#define LOG_EVENTS LOG_EVENTS_BINARY
+#endif
+
+/*
+ * Event record: [0xA0 | argc][id][ms, 16 bit][args, 32 bit each], little-endian.
+ * The first byte is never ASCII, so records and text lines share the UART.
+ */
+
+#define LOGGER_RECORD      0xA0
+#define LOGGER_RECORD_ARGS 2
+
+/*
+ * Event IDs, Tools/log_decoder.py has the matching formats
+ */
+
+#define LOG_EV_BOOT        0x01
+#define LOG_EV_ETH_MAC     0x02
+#define LOG_EV_ETH_PHY     0x03
+#define LOG_EV_ETH_REV     0x04
+#define LOG_EV_LWIP_ASSERT 0x05
+#define LOG_EV_UDP_ERR     0x10
+#define LOG_EV_UDP_NO_PCB  0x11
+#define LOG_EV_UDP_NO_PBUF 0x12
+#define LOG_EV_COLLECTOR   0x13
+#define LOG_EV_REPORT_LOST 0x14
+#define LOG_EV_REPORT_RTX  0x15
+#define LOG_EV_REPORT_PBUF 0x16
+#define LOG_EV_REPORT_BIG  0x17
+#define LOG_EV_CARD_SENT   0x20
+#define LOG_EV_ALIVE_SENT  0x21
+#define LOG_EV_CARD_CLEAR  0x22
+#define LOG_EV_CARDS_SENT  0x23
+#define LOG_EV_CARD_SLOW   0x24
+#define LOG_EV_SPI_FRAME   0x30
+#define LOG_EV_LOG_DROPPED 0x31
+#define LOG_EV_CSUM_TX     0x32
+#define LOG_EV_RFID_RATE   0x33
+#define LOG_EV_RFID_POWER  0x34
+#define LOG_EV_CARD_TIME   0x35
+#define LOG_EV_HEAP        0x36
+#define LOG_EV_LWIP_MEM    0x37
+#define LOG_EV_LWIP_POOL   0x38
+#define LOG_EV_CSUM_RX     0x39
+
+// Text messages, a newline is added
+#if LOG_LEVEL >= LOG_LEVEL_ERROR
+#define LOG_ERROR(fmt, ...) printf("E: " fmt "\n", ##__VA_ARGS__)
+#else
+#define LOG_ERROR(fmt, ...) do {} while (0)
+#endif
+
+#if LOG_LEVEL >= LOG_LEVEL_WARN
+#define LOG_WARN(fmt, ...) printf("W: " fmt "\n", ##__VA_ARGS__)
+#else
+#define LOG_WARN(fmt, ...) do {} while (0)
+#endif
+
+#if LOG_LEVEL >= LOG_LEVEL_INFO
+#define LOG_INFO(fmt, ...) printf(fmt "\n", ##__VA_ARGS__)
+#else
+#define LOG_INFO(fmt, ...) do {} while (0)
+#endif
+
+#if LOG_LEVEL >= LOG_LEVEL_DEBUG
+#define LOG_DEBUG(fmt, ...) printf("D: " fmt "\n", ##__VA_ARGS__)
+#else
+#define LOG_DEBUG(fmt, ...) do {} while (0)
+#endif
+
+// Hot-path events with up to 2 arguments. fmt is only used for text output
+// and must print the arguments as unsigned long (%lu, %lX) or long (%ld).
+#if LOG_EVENTS == LOG_EVENTS_BINARY
+#define LOG_EVENT0(id, fmt)       logger_event((id), 0, 0, 0)
+#define LOG_EVENT1(id, fmt, a)    logger_event((id), 1, (a), 0)
+#define LOG_EVENT2(id, fmt, a, b) logger_event((id), 2, (a), (b))
+#elif LOG_EVENTS == LOG_EVENTS_TEXT
+#define LOG_EVENT0(id, fmt)       printf(fmt "\n")
+#define LOG_EVENT1(id, fmt, a)    printf(fmt "\n", (unsigned long)(a))
+#define LOG_EVENT2(id, fmt, a, b) printf(fmt "\n", (unsigned long)(a), (unsigned long)(b))
+#else
+#define LOG_EVENT0(id, fmt)       ((void)0)
+#define LOG_EVENT1(id, fmt, a)    ((void)(a))
+#define LOG_EVENT2(id, fmt, a, b) ((void)(a), (void)(b))
+#endif
+
+// Start draining the ring into USART1, call after USART1 is enabled
+void logger_init(void);
+
+// Queue log output and return at once, a write that does not fit the ring is dropped whole.
+// Single producer: call from the main loop only, never from an interrupt.
+int logger_write(const char *data, int len);
+
+// Queue one binary event record
+void logger_event(uint8_t id, uint8_t argc, uint32_t arg0, uint32_t arg1);
+
+// Number of writes (records or text) dropped so far
+uint32_t logger_dropped(void);
+
+// USART1 TXE interrupt
+void logger_irq(void);
+
+#endif // __LOGGER_H
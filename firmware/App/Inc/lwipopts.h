@@ -20,37 +20,68 @@ extern uint32_t sys_now(void);
 // #define LWIP_IPV6                       0 // (default = 0)
 // #define LWIP_RAW                        0 // (default = 0) no hook into the IP layer itself
 #define LWIP_ICMP                       1 // (default = 1)
-// #define LWIP_IGMP                       0 // (default = 0)
+#define LWIP_IGMP                       1 // (default = 0) multicast groups drive the ENC28J60 hash filter
 #define LWIP_UDP                        1 // (default = 1)
-#define LWIP_TCP                        1 // (default = 1)
+#define LWIP_TCP                        0 // (default = 1) reports go over UDP, no TCP PCB/segment pools
 #define LWIP_DHCP                       1 // (default = 0)
+#define LWIP_HOOK_FILENAME              "report.h" // DHCP option with the collector's address
+#define LWIP_HOOK_DHCP_PARSE_OPTION(netif, dhcp, state, msg, msg_type, option, len, pbuf, offset) \
+    report_dhcp_option(msg_type, option, len, pbuf, offset)
 // #define LWIP_DNS                        1 // (default = 0)
 // #define DNS_MAX_SERVERS                 5 // (default = 2)
 // #define LWIP_RAND                       sys_now // (default = rand) use sys_now() as random function
 // #define LWIP_DNS_SUPPORT_MDNS_QUERIES   1 // (default = 0)
 
-/* Memory */
-// #define MEM_ALIGNMENT               4 // (default = 1) should be set to the alignment of the CPU
-#define MEM_LIBC_MALLOC             1 // (default = 0) use malloc/free/realloc provided by C-library
-// #define MEMP_NUM_PBUF               16 // (default = 16) the number of memp struct pbufs (used for PBUF_ROM and PBUF_REF)
+/* Memory: static heap and pools, sized for one frame in flight each way.
+   Peak use shows in the alive log (MEM_STATS/MEMP_STATS), Tools/ram_budget.py checks the total */
+#define MEM_ALIGNMENT               4 // (default = 1) should be set to the alignment of the CPU
+#define MEM_LIBC_MALLOC             0 // (default = 0) lwIP heap is a static array, not newlib's sbrk
+#define MEMP_MEM_MALLOC             0 // (default = 0) pools are static arrays too
+#define MEM_SIZE                    1600 // (default = 1600) PBUF_RAM: a DHCP message (~600 bytes), ARP and IGMP replies
+#define MEMP_NUM_PBUF               4 // (default = 16) the number of memp struct pbufs (used for PBUF_ROM and PBUF_REF)
 // #define MEMP_NUM_RAW_PCB            4 // (default = 4) the number of RAW connection PCBs
-// #define MEMP_NUM_UDP_PCB            4 // (default = 4) the number of UDP connection PCBs
-// #define MEMP_NUM_TCP_PCB            5 // (default = 5) the number of TCP connection PCBs
-// #define MEMP_NUM_TCP_PCB_LISTEN     8 // (default = 8) the number of listening TCP connections
-// #define PBUF_POOL_SIZE              16 // (default = 16) the number of buffers in the pbuf pool
+#define MEMP_NUM_UDP_PCB            3 // (default = 4) DHCP, reports, one spare
+#define MEMP_NUM_ARP_QUEUE          4 // (default = 30) packets waiting for an ARP reply
+#define MEMP_NUM_IGMP_GROUP         4 // (default = 8) allsystems and a few groups
+#define ARP_TABLE_SIZE              4 // (default = 10) gateway, collector, a couple of hosts
+#define PBUF_POOL_SIZE              6 // (default = 16) Rx is handled frame by frame: a full-size frame takes 3
+#define PBUF_POOL_BUFSIZE           512 // (default = TCP_MSS + 54)
+#define IP_REASSEMBLY               0 // (default = 1) nothing sent to the reader is ever fragmented
+#define IP_FRAG                     0 // (default = 1) reports are far below the MTU
+#define LWIP_SUPPORT_CUSTOM_PBUF        1 // (default = IP_FRAG) report.c sends from static custom pbufs
+
+/* Checksum */
+#define ETH_CHECKSUM_OFFLOAD            0 // (app) the ENC28J60 DMA engine generates IP/ICMP/UDP/TCP checksums, Rx is paused while it runs: off until ETH_CHECKSUM_BENCH shows it pays
+#define CHECKSUM_GEN_IP                 (!ETH_CHECKSUM_OFFLOAD) // (default = 1)
+#define CHECKSUM_GEN_ICMP               (!ETH_CHECKSUM_OFFLOAD) // (default = 1)
+#define CHECKSUM_GEN_UDP                (!ETH_CHECKSUM_OFFLOAD) // (default = 1)
+#define CHECKSUM_GEN_TCP                (!ETH_CHECKSUM_OFFLOAD) // (default = 1)
+// #define CHECKSUM_CHECK_IP               1 // (default = 1) received frames are always checked in software
+// #define CHECKSUM_CHECK_ICMP             1 // (default = 1)
+// #define CHECKSUM_CHECK_UDP              1 // (default = 1)
+// #define CHECKSUM_CHECK_TCP              1 // (default = 1)
 
 /* Network Interface */
 #define LWIP_SINGLE_NETIF               1 // (default = 0) use a single netif only, no routing
 // #define LWIP_NETIF_HOSTNAME             0 // (default = 0)
 // #define LWIP_NETIF_API                  0 // (default = 0)
-// #define LWIP_NETIF_STATUS_CALLBACK      0 // (default = 0)
+#define LWIP_NETIF_STATUS_CALLBACK      1 // (default = 0) address changes drive the ENC28J60 Rx filters
 // #define LWIP_NETIF_EXT_STATUS_CALLBACK  0 // (default = 0)
 // #define LWIP_NETIF_LINK_CALLBACK        0 // (default = 0)
 // #define LWIP_NETIF_REMOVE_CALLBACK      0 // (default = 0)
 // #define LWIP_NETIF_LOOPBACK             0 // (default = 0)
 
-/* Statistics */
-#define LWIP_STATS                      0 // (default = 1) no statistics collection
+/* Statistics: only memory, to size the pools from measured peaks */
+#define LWIP_STATS                      1 // (default = 1)
+#define LINK_STATS                      0 // (default = 1)
+#define ETHARP_STATS                    0 // (default = 1)
+#define IP_STATS                        0 // (default = 1)
+#define IGMP_STATS                      0 // (default = 0)
+#define ICMP_STATS                      0 // (default = 1)
+#define UDP_STATS                       0 // (default = 1)
+#define SYS_STATS                       0 // (default = 1)
+#define MEM_STATS                       1 // (default = 1)
+#define MEMP_STATS                      1 // (default = 1)
 
 /* Debugging */
 // #define LWIP_DEBUG                      0 // (default = 0) enable printing messages to stdout
@@ -1,12 +1,23 @@
 #ifndef __MFRC522_H
 #define __MFRC522_H
 
+#include <stdint.h>
+
 #define uchar unsigned char
 #define uint  unsigned int
 
 // Maximum bytes in a block
 #define MF_BLOCK_SIZE 16
 
+// MFRC522 FIFO, the longest answer it can take in one exchange
+#define MFRC522_FIFO_SIZE 64
+
+// NTAG21x / Ultralight (ISO14443-3 Type 2): 4-byte pages, user memory from page 4.
+// A FAST_READ answer and its CRC_A must fit the FIFO: 15 pages per frame.
+#define NTAG_PAGE_SIZE      4
+#define NTAG_USER_PAGE      4
+#define NTAG_FAST_READ_MAX  15
+
 // MFRC522 commands. Described in chapter 10 of the datasheet.
 #define PCD_IDLE       0x00 // no action, cancels current command execution
 #define PCD_AUTHENT    0x0E // performs the MIFARE standard authentication as a reader
@@ -20,6 +31,11 @@
 #define PICC_REQIDL    0x26 // REQuest command, Type A. Invites PICCs in state IDLE to go to READY and prepare for anticollision or selection. 7 bit frame.
 #define PICC_REQALL    0x52 // Wake-UP command, Type A. Invites PICCs in state IDLE and HALT to go to READY(*) and prepare for anticollision or selection. 7 bit frame.
 #define PICC_ANTICOLL  0x93 // Anti collision/Select, Cascade Level 1
+#define PICC_ANTICOLL_CL2 0x95 // Anti collision/Select, Cascade Level 2
+#define PICC_ANTICOLL_CL3 0x97 // Anti collision/Select, Cascade Level 3
+#define PICC_CT        0x88 // Cascade Tag, first UID byte of a level when the UID goes on
+#define PICC_SAK_CASCADE 0x04 // SAK bit: UID not complete
+#define PICC_SAK_CLASSIC 0x08 // SAK bit: MIFARE Classic, sectors behind Crypto1 keys
 #define PICC_SElECTTAG 0x93 // Anti collision/Select, Cascade Level 2
 #define PICC_AUTHENT1A 0x60 // Perform authentication with Key A
 #define PICC_AUTHENT1B 0x61 // Perform authentication with Key B
@@ -30,11 +46,30 @@
 #define PICC_RESTORE   0xC2 // Reads the contents of a block into the internal data register.
 #define PICC_TRANSFER  0xB0 // Writes the contents of the internal data register to a block.
 #define PICC_HALT      0x50 // HaLT command, Type A. Instructs an ACTIVE PICC to go to state HALT.
+#define PICC_GET_VERSION 0x60 // NTAG/Ultralight EV1: vendor, type and memory size in 8 bytes. Same code as AUTHENT1A.
+#define PICC_FAST_READ   0x3A // NTAG/Ultralight EV1: reads pages start..end in one frame.
 
 // Success or error code is returned when communication
 #define MI_OK       0
 #define MI_NOTAGERR 1
 #define MI_ERR      2
+#define MI_BUSY     3 // command still running, poll again
+#define MI_COLL     4 // bit collision, CollReg has its position
+
+// Default receiver setup, restored after a low-power sense pulse
+#define MFRC522_RFCFG       0x70 // RxGain 48 dB
+#define MFRC522_RXTHRESHOLD 0x84 // MinLevel 8, CollLevel 4 (reset value)
+
+// Per-command timeouts in us, counted by the MFRC522 timer (100 us tick) from the end
+// of the sent frame to the start of the answer. The ISO14443-3 frame delay time is
+// about 91 us for REQA, ANTICOLLISION and SELECT; MIFARE memory commands answer
+// after their EEPROM access. HLTA is never answered, 1 ms of silence means done.
+#define MFRC522_TIMEOUT_SHORT 1000
+#define MFRC522_TIMEOUT_AUTH  5000
+#define MFRC522_TIMEOUT_READ  5000
+#define MFRC522_TIMEOUT_WRITE 10000
+#define MFRC522_TIMEOUT_FAST_READ 10000 // the answer starts quickly, but 62 bytes take 6 ms on air
+#define MFRC522_GUARD         2 // ms past the chip timeout before the blocking calls give up
 
 // MFRC522 registers. Described in chapter 9 of the datasheet.
 // Page 0: Command and Status
@@ -106,6 +141,20 @@
 #define Reserved33      0x3E
 #define Reserved34      0x3F
 
+// UID resolved by the cascade anticollision/select sequence
+typedef struct {
+    uchar level;      // cascade level 0..2
+    uchar known_bits; // UID bits of this level fixed so far
+    uchar frame[9];   // SEL NVB UID0..3 BCC CRC_A
+    uchar uid[10];    // 4, 7 or 10 bytes
+    uchar uid_len;
+    uchar sak;
+} mfrc522_uid_t;
+
+typedef struct {
+    uint32_t spi; // SPI transactions (CS frames)
+} mfrc522_stats_t;
+
 // Functions for manipulating the MFRC522
 void mfrc522_init(void);
 uchar mfrc522_request(uchar reqMode, uchar *TagType);
@@ -116,4 +165,41 @@ uchar mfrc522_read_block(uchar blockAddr, uchar *recvData);
 uchar mfrc522_write_block(uchar blockAddr, uchar *writeData);
 void mfrc522_halt(void);
 
+// Asynchronous communication: start, then poll until it is not MI_BUSY
+uchar mfrc522_transceive_start(uchar command, uchar *sendData, uchar sendBytes);
+uchar mfrc522_transceive_poll(uchar *recvData, uint *recvBits);
+void mfrc522_transceive_cancel(void);
+uchar mfrc522_request_start(uchar reqMode);
+uchar mfrc522_request_poll(uchar *TagType);
+void mfrc522_uid_init(mfrc522_uid_t *uid);
+uchar mfrc522_anticoll_start(mfrc522_uid_t *uid);
+uchar mfrc522_anticoll_poll(mfrc522_uid_t *uid);
+uchar mfrc522_select_level_start(mfrc522_uid_t *uid);
+uchar mfrc522_select_level_poll(mfrc522_uid_t *uid);
+uchar mfrc522_read_block_start(uchar blockAddr);
+uchar mfrc522_read_block_poll(uchar *recvData);
+uchar mfrc522_halt_start(void);
+uchar mfrc522_halt_poll(uchar *buf);
+uchar mfrc522_auth_start(uchar authMode, uchar BlockAddr, const uchar *Sectorkey, const uchar *serNum);
+uchar mfrc522_auth_poll(void);
+void mfrc522_stop_crypto1(void);
+
+// NTAG21x / Ultralight. mfrc522_read_block() reads 4 pages from blockAddr.
+uchar mfrc522_ntag_detect(const uchar *atqa, uchar sak);
+uchar mfrc522_ntag_get_version(uchar *version);
+uint mfrc522_ntag_user_pages(const uchar *version);
+uchar mfrc522_ntag_fast_read(uint start, uint end, uchar *recvData);
+uchar mfrc522_ntag_read_ndef(uchar *recvData, uint size, uint *len);
+uchar mfrc522_ntag_version_start(void);
+uchar mfrc522_ntag_version_poll(uchar *recvData);
+uchar mfrc522_ntag_fast_read_start(uchar start, uchar end);
+uchar mfrc522_ntag_fast_read_poll(uchar *recvData);
+
+// Power control for low-power card detection
+void mfrc522_antenna(uchar on);
+void mfrc522_power_down(uchar on);
+void mfrc522_set_timeout(uint us);
+void mfrc522_set_receiver(uchar rfcfg, uchar threshold);
+const mfrc522_stats_t *mfrc522_get_stats(void);
+
 #endif // __MFRC522_H
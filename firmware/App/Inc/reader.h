@@ -0,0 +1,137 @@
+#ifndef __READER_H
+#define __READER_H
+
+#include "mfrc522.h"
+#include <stdint.h>
+
+/*
+ * Card polling
+ */
+
+#define READER_POLL_INTERVAL  0   // ms between two inventory sweeps
+#define READER_INVENTORY_MAX  8   // cards per sweep
+#define READER_INVENTORY_MISS 2   // failed cards per sweep before giving up on the rest
+#define READER_CARD_BUDGET    100 // ms from REQA to HALT per card, slower cards are logged
+
+/*
+ * MIFARE Classic payload: after select, authenticate once with a key of READER_KEYS
+ * (the one that worked last is tried first) and read the first READER_READ_BLOCKS
+ * blocks of READER_READ_SECTOR back to back. Other cards report their UID only.
+ */
+
+#define READER_READ_SECTOR -1 // sector read after select, -1 = UID only
+#define READER_READ_BLOCKS 3  // data blocks, the sector trailer holds the keys
+#define READER_KEY_TYPE    PICC_AUTHENT1A
+#define READER_KEYS                                             \
+    {                                                           \
+        {0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF}, /* transport */   \
+        {0xA0, 0xA1, 0xA2, 0xA3, 0xA4, 0xA5}, /* MAD */         \
+        {0xD3, 0xF7, 0xD3, 0xF7, 0xD3, 0xF7}, /* NFC Forum */   \
+    }
+
+/*
+ * NTAG21x / Ultralight EV1 payload (ATQA 0x0044, SAK 0x00): after select, GET_VERSION
+ * for the memory size, then FAST_READ of the first READER_NTAG_PAGES user pages from
+ * page 4, 15 pages per frame at most. They are reported as blocks of 4 pages.
+ * Tags without GET_VERSION (Ultralight, Ultralight C) report their UID only.
+ */
+
+#define READER_NTAG_PAGES 0 // user pages read after select, a multiple of 4, 0 = UID only
+
+// Cards carry data beyond their UID, Classic blocks or NTAG pages
+#define READER_CARD_DATA (READER_READ_SECTOR >= 0 || READER_NTAG_PAGES > 0)
+#if READER_READ_SECTOR >= 0 && READER_READ_BLOCKS * MF_BLOCK_SIZE > READER_NTAG_PAGES * NTAG_PAGE_SIZE
+#define READER_DATA_BLOCKS READER_READ_BLOCKS
+#else
+#define READER_DATA_BLOCKS (READER_NTAG_PAGES * NTAG_PAGE_SIZE / MF_BLOCK_SIZE)
+#endif
+#if READER_NTAG_PAGES % (MF_BLOCK_SIZE / NTAG_PAGE_SIZE)
+#error "READER_NTAG_PAGES must be a multiple of 4"
+#endif
+
+/*
+ * Low-power card detection. The MFRC522 has no LPCD block of its own, so between
+ * sweeps the antenna is switched off and the chip sleeps in soft power-down. Every
+ * READER_LPCD_INTERVAL ms it wakes up for a sense pulse: field on, a few ms for the
+ * cards to power up, one WUPA with a short timer. Only an answer starts full sweeps,
+ * they go on back to back until one of them finds no card.
+ */
+
+#define READER_LPCD             1
+#define READER_LPCD_INTERVAL    200  // ms between two sense pulses
+#define READER_LPCD_SETTLE      3    // ms of field before the WUPA
+#define READER_LPCD_RFCFG       0x70 // RFCfgReg during sense pulses, RxGain 48 dB
+#define READER_LPCD_RXTHRESHOLD 0x84 // RxThresholdReg during sense pulses, MinLevel 8
+
+/*
+ * Per-state guards in ms, the MFRC522 timer normally ends a silent exchange
+ * first (MFRC522_TIMEOUT_*, 1 ms for REQA)
+ */
+
+#define READER_REQA_TIMEOUT     3
+#define READER_ANTICOLL_TIMEOUT 40 // one cascade level, up to 32 collision rounds
+#define READER_SELECT_TIMEOUT   3
+#define READER_AUTH_TIMEOUT     8
+#define READER_READ_TIMEOUT     8
+#define READER_HALT_TIMEOUT     3
+#define READER_VERSION_TIMEOUT  3
+#define READER_PAGES_TIMEOUT    12 // one FAST_READ frame
+
+/*
+ * reader_poll() results
+ */
+
+#define READER_NONE  0 // nothing new
+#define READER_SWEEP 1 // an inventory sweep is over, see reader_sweep()
+
+typedef enum {
+    READER_IDLE = 0,
+    READER_REQA,
+    READER_ANTICOLL,
+    READER_SELECT,
+    READER_AUTH,
+    READER_READ,
+    READER_VERSION, // NTAG GET_VERSION
+    READER_PAGES,   // NTAG FAST_READ
+    READER_HALT,
+    READER_SLEEP, // LPCD: antenna off, waiting for the next sense pulse
+    READER_SENSE, // LPCD: antenna on, waiting for the field to settle
+} reader_state_t;
+
+typedef struct {
+    uint8_t atqa[2];
+    uint8_t uid[10]; // 4, 7 or 10 bytes
+    uint8_t uid_len;
+    uint8_t sak;
+#if READER_CARD_DATA
+    uint8_t blocks; // blocks of the sector or of 4 NTAG pages read, 0 = UID only
+    uint8_t data[READER_DATA_BLOCKS * MF_BLOCK_SIZE];
+#endif
+} reader_card_t;
+
+// Every card that answered during one sweep
+typedef struct {
+    uint8_t count;
+    reader_card_t cards[READER_INVENTORY_MAX];
+} reader_sweep_t;
+
+typedef struct {
+    uint32_t sweeps;
+    uint32_t tags;
+    uint32_t senses;   // LPCD sense pulses
+    uint32_t field_ms; // time spent with the antenna on
+    uint32_t card_ms;  // REQA to HALT, summed over the tags
+    uint32_t card_max; // slowest card
+    uint32_t slow;     // cards over READER_CARD_BUDGET
+} reader_stats_t;
+
+// Advance the reader by one step, it never waits for the card.
+// A sweep wakes every card with WUPA, then each REQA brings one more
+// idle card through anticollision, select and HALT until nobody answers.
+// With READER_LPCD the reader sleeps between sense pulses while the field is empty.
+uint8_t reader_poll(void);
+const reader_sweep_t *reader_sweep(void);
+const reader_stats_t *reader_get_stats(void);
+reader_state_t reader_state(void);
+
+#endif // __READER_H
@@ -0,0 +1,106 @@
+#ifndef __REPORT_H
+#define __REPORT_H
+
+#include <stdint.h>
+
+/*
+ * UDP reports to the collector
+ */
+
+#define REPORT_PORT      12345
+#define REPORT_POOL_SIZE 4   // messages in flight at once (ARP queue, ENC28J60 Tx queue)
+#define REPORT_DATA_MAX  192 // bytes per message
+
+/*
+ * Event batching: events are queued with their time and go out together in one
+ * TYPE_EVENTS datagram once REPORT_BATCH_EVENTS are in, REPORT_BATCH_MS after the
+ * first one, or when the next one does not fit.
+ * [ID0][ID1][ID2][0x05][VER][N][SEQ, 2 bytes][T0, 4 bytes] then N times [DT, 2 bytes][type][LEN][payload]
+ * SEQ counts batches from boot, T0 is the ms since boot of the first event,
+ * DT the ms since T0, all big-endian.
+ */
+
+#define REPORT_BATCH         1  // 0 = one datagram per event
+#define REPORT_BATCH_EVENTS  8  // N
+#define REPORT_BATCH_MS      50 // T
+#define REPORT_TYPE_EVENTS   5  // TYPE_EVENTS in app.c
+#define REPORT_EVENTS_VER    2
+#define REPORT_EVENTS_HLEN   12 // header up to T0
+
+/*
+ * Retransmits: each batch stays in a ring until the collector answers
+ * [ID0][ID1][ID2][0x85][SEQ, 2 bytes], and is sent again REPORT_RETRY_MS later,
+ * twice that after, up to REPORT_RETRY_MAX_MS, REPORT_RETRIES times at most.
+ * A full ring gives up its oldest batch. Needs REPORT_BATCH, 0 = no retransmits.
+ */
+
+#define REPORT_RING_SIZE    4 // batches, REPORT_DATA_MAX bytes each
+#define REPORT_RETRY_MS     200
+#define REPORT_RETRY_MAX_MS 3200
+#define REPORT_RETRIES      6
+#define REPORT_TYPE_ACK     0x85
+
+/*
+ * Collector discovery: reports go unicast to the collector once it is known and
+ * to 255.255.255.255 until then. Sources, the first one found wins:
+ * - REPORT_COLLECTOR_IP, a fixed address ("" = discover)
+ * - DHCP option REPORT_DHCP_OPTION, 4 bytes, the collector's address, in the ACK
+ *   of the lease
+ * - a probe [ID0][ID1][ID2][0x06] broadcast every REPORT_PROBE_MS, the collector
+ *   answers [ID0][ID1][ID2][0x86] to the sender within REPORT_PROBE_WAIT_MS
+ * A probed collector is forgotten, and probed for again, when the address changes
+ * or REPORT_PROBE_LOST batches in a row are never ACKed.
+ */
+
+#define REPORT_COLLECTOR_IP  ""
+#define REPORT_DHCP_OPTION   224 // site-specific range
+#define REPORT_PROBE_MS      5000
+#define REPORT_PROBE_WAIT_MS 1000
+#define REPORT_PROBE_LOST    2
+#define REPORT_TYPE_PROBE    6
+#define REPORT_TYPE_HERE     0x86
+
+#define REPORT_SRC_NONE   0
+#define REPORT_SRC_STATIC 1
+#define REPORT_SRC_DHCP   2
+#define REPORT_SRC_PROBE  3
+
+struct pbuf;
+
+/*
+ * report_send() results
+ */
+
+#define REPORT_OK   0
+#define REPORT_BUSY 1 // every buffer still in flight, worth another try later
+#define REPORT_ERR  2 // no PCB, too long, no pbuf or udp_sendto failed
+
+typedef struct {
+    uint32_t sent;
+    uint32_t busy;    // dropped, every buffer still in flight
+    uint32_t failed;  // dropped, pbuf_alloced_custom() refused the buffer
+    uint32_t events;  // events queued for a batch
+    uint32_t dropped; // events too big for an empty batch
+    uint32_t acked;
+    uint32_t retries;
+    uint32_t lost;    // batches never ACKed
+} report_stats_t;
+
+// One UDP PCB for the whole run and a static pool of custom pbufs:
+// nothing is allocated once report_init() is done
+void report_init(const uint8_t *id);
+uint8_t report_send(const uint8_t *data, uint16_t len);
+
+// Queue one event for the next batch, report_poll() sends it when its time is up
+void report_event(uint8_t type, const uint8_t *payload, uint8_t len);
+void report_flush(void);
+void report_poll(void);
+
+// LWIP_HOOK_DHCP_PARSE_OPTION in lwipopts.h, picks the collector from a DHCP reply
+void report_dhcp_option(uint8_t msg_type, uint8_t option, uint8_t len, struct pbuf *p, uint16_t offset);
+const report_stats_t *report_get_stats(void);
+
+// Heap bytes in use now and the most ever taken from sbrk
+void report_heap(uint32_t *used, uint32_t *peak);
+
+#endif // __REPORT_H
@@ -1,16 +1,23 @@
 #include "app.h"
 #include "enc28j60.h"
+#include "logger.h"
 #include "main.h"
 #include "mfrc522.h"
+#include "reader.h"
+#include "report.h"
 
 #include <lwip/dhcp.h>
 #include <lwip/dns.h>
 #include <lwip/err.h>
 #include <lwip/etharp.h>
+#include <lwip/inet_chksum.h>
 #include <lwip/init.h>
+#include <lwip/memp.h>
 #include <lwip/netif.h>
 #include <lwip/pbuf.h>
-#include <lwip/tcp.h>
+#include <lwip/prot/ip.h>
+#include <lwip/prot/ip4.h>
+#include <lwip/stats.h>
 #include <lwip/timeouts.h>
 
 #include <stdint.h>
@@ -25,7 +32,31 @@ uint32_t sys_now(void) {
 
 static uint8_t mac_addr[6];
 static struct netif eth0;
-static uint8_t pkt_buf[ENC28J60_MAXFRAME];
+
+#if LWIP_IGMP
+static err_t ethernetif_igmp_mac_filter(struct netif *netif, const ip4_addr_t *group, enum netif_mac_filter_action action) {
+    (void)netif;
+    /* IPv4 multicast MAC: 01:00:5E + lower 23 bits of the group address */
+    uint8_t mac[6] = {0x01, 0x00, 0x5E, ip4_addr2(group) & 0x7F, ip4_addr3(group), ip4_addr4(group)};
+
+    if (action == NETIF_ADD_MAC_FILTER) {
+        enc28j60_hash_add(mac);
+    } else {
+        enc28j60_hash_remove(mac);
+    }
+    return ERR_OK;
+}
+#endif
+
+static void ethernetif_status_callback(struct netif *netif) {
+    /* once there is an address, the only broadcast we need is ARP */
+    if (netif_is_up(netif) && !ip4_addr_isany_val(*netif_ip4_addr(netif))) {
+        enc28j60_set_filter(ENC28J60_FILTER_UNICAST | ENC28J60_FILTER_ARP | ENC28J60_FILTER_MULTICAST);
+        LOG_INFO("IP = %s", ip4addr_ntoa(netif_ip4_addr(netif)));
+    } else {
+        enc28j60_set_filter(ENC28J60_FILTER_UNICAST | ENC28J60_FILTER_BROADCAST | ENC28J60_FILTER_MULTICAST);
+    }
+}
 
 static void low_level_init(struct netif *netif) {
     /* set MAC hardware address */
@@ -38,39 +69,254 @@ static void low_level_init(struct netif *netif) {
     netif->hwaddr[5] = mac_addr[5];
 
     /* maximum transfer unit */
-    netif->mtu = ENC28J60_MAXFRAME;
+    netif->mtu = 1500; /* a full frame still fits one Tx slot */
 
     /* hardware initialization */
     enc28j60_init(mac_addr);
-    printf("MAC = %02X:%02X:%02X:%02X:%02X:%02X\n",
-           mac_addr[0],
-           mac_addr[1],
-           mac_addr[2],
-           mac_addr[3],
-           mac_addr[4],
-           mac_addr[5]);
+    LOG_EVENT2(LOG_EV_ETH_MAC, "MAC = %06lX%06lX",
+               (mac_addr[0] << 16) | (mac_addr[1] << 8) | mac_addr[2],
+               (mac_addr[3] << 16) | (mac_addr[4] << 8) | mac_addr[5]);
     uint16_t phid1 = enc28j60_read_phy(PHID1);
-    printf("ID1 = 0x%04X\n", phid1);
     uint16_t phid2 = enc28j60_read_phy(PHID2);
-    printf("ID2 = 0x%04X\n", phid2);
+    LOG_EVENT2(LOG_EV_ETH_PHY, "ID1 = 0x%04lX, ID2 = 0x%04lX", phid1, phid2);
     uint8_t erevid = enc28j60_rcr(EREVID);
-    printf("REV = 0x%02X\n", erevid);
+    LOG_EVENT1(LOG_EV_ETH_REV, "REV = 0x%02lX", erevid);
+
+    /* accept broadcast until there is an address, DHCP offers may be broadcast */
+    enc28j60_set_filter(ENC28J60_FILTER_UNICAST | ENC28J60_FILTER_BROADCAST | ENC28J60_FILTER_MULTICAST);
 
     /* device capabilities */
     /* don't set NETIF_FLAG_ETHARP if this device is not an ethernet one */
     netif->flags |= NETIF_FLAG_BROADCAST | NETIF_FLAG_ETHARP | NETIF_FLAG_ETHERNET | NETIF_FLAG_LINK_UP;
+#if LWIP_IGMP
+    netif->flags |= NETIF_FLAG_IGMP;
+    netif_set_igmp_mac_filter(netif, ethernetif_igmp_mac_filter);
+#endif
 }
 
-static err_t low_level_output(struct netif *netif, struct pbuf *p) {
-    (void)netif;
+#if ETH_CHECKSUM_OFFLOAD
+/* time the checksum engine against lwIP's software checksums over the same spans,
+   for sent frames and, engine result unused, for received ones */
+#define ETH_CHECKSUM_BENCH 0
+
+#if ETH_CHECKSUM_BENCH
+typedef struct {
+    uint32_t frames;
+    uint32_t hw_cycles;
+    uint32_t sw_cycles;
+} eth_csum_bench_t;
+
+static eth_csum_bench_t eth_csum_tx_bench = {0};
+static eth_csum_bench_t eth_csum_rx_bench = {0};
+#endif
+
+/* where the checksums of an IPv4 frame are */
+typedef struct {
+    u8_t proto;
+    u16_t ip_hlen;  /* IP header length */
+    u16_t seg_len;  /* transport segment length */
+    u16_t csum_pos; /* checksum offset in transport header, 0 if there is none to handle */
+    u16_t pseudo;   /* pseudo header sum */
+} eth_csum_t;
+
+static u16_t ethernetif_csum_fold(u32_t sum) {
+    sum = (sum & 0xFFFF) + (sum >> 16);
+    sum = (sum & 0xFFFF) + (sum >> 16);
+    return (u16_t)sum;
+}
+
+/* Parse the IPv4 header of a frame, return 0 if it is not one */
+static u8_t ethernetif_csum_parse(struct pbuf *p, eth_csum_t *c) {
+    u8_t hdr[SIZEOF_ETH_HDR + IP_HLEN];
+    const u8_t *ip = hdr + SIZEOF_ETH_HDR;
+    u16_t ip_len;
+
+    if (pbuf_copy_partial(p, hdr, sizeof(hdr), 0) != sizeof(hdr)) {
+        return 0;
+    }
+    if (hdr[12] != 0x08 || hdr[13] != 0x00 || (ip[0] >> 4) != 4) {
+        return 0;
+    }
+
+    c->proto = ip[9];
+    c->ip_hlen = (ip[0] & 0x0F) * 4;
+    ip_len = (ip[2] << 8) | ip[3];
+    if (c->ip_hlen < IP_HLEN || ip_len < c->ip_hlen || SIZEOF_ETH_HDR + ip_len > p->tot_len) {
+        return 0;
+    }
+    c->seg_len = ip_len - c->ip_hlen;
+    c->csum_pos = 0;
+    c->pseudo = 0;
+
+    /* a fragment only holds part of the transport checksum */
+    if ((ip[6] & 0x3F) || ip[7]) {
+        return 1;
+    }
+
+    switch (c->proto) {
+    case IP_PROTO_ICMP:
+        c->csum_pos = 2;
+        break;
+    case IP_PROTO_UDP:
+        c->csum_pos = 6;
+        break;
+    case IP_PROTO_TCP:
+        c->csum_pos = 16;
+        break;
+    default:
+        return 1;
+    }
+    if (c->csum_pos + 2 > c->seg_len) {
+        c->csum_pos = 0;
+        return 1;
+    }
+
+    if (c->proto != IP_PROTO_ICMP) {
+        /* source and destination address, protocol, segment length */
+        u32_t sum = 0;
+        for (u8_t i = 12; i < 20; i += 2) {
+            sum += (ip[i] << 8) | ip[i + 1];
+        }
+        c->pseudo = ethernetif_csum_fold(sum + c->proto + c->seg_len);
+    }
+    return 1;
+}
+
+#if ETH_CHECKSUM_BENCH
+/* What lwIP does instead: the IP header, then the segment with its pseudo header */
+static void ethernetif_csum_sw(struct pbuf *p, const eth_csum_t *c) {
+    u16_t seg = SIZEOF_ETH_HDR + c->ip_hlen;
+    const u8_t *ip = (const u8_t *)p->payload + SIZEOF_ETH_HDR;
+    ip_addr_t src, dest;
+
+    (void)inet_chksum(ip, c->ip_hlen);
+    if (!c->csum_pos) {
+        return;
+    }
+    SMEMCPY(&src, ip + 12, sizeof(src));
+    SMEMCPY(&dest, ip + 16, sizeof(dest));
+    pbuf_remove_header(p, seg);
+    if (c->proto == IP_PROTO_ICMP) {
+        (void)inet_chksum_pbuf(p);
+    } else {
+        (void)ip_chksum_pseudo(p, c->proto, c->seg_len, &src, &dest);
+    }
+    pbuf_add_header_force(p, seg);
+}
+
+/* Frame headers all in the first pbuf, as lwIP builds them and as the pool holds them */
+static void ethernetif_csum_bench_sw(eth_csum_bench_t *bench, struct pbuf *p, const eth_csum_t *c) {
+    if (p->len < SIZEOF_ETH_HDR + c->ip_hlen) {
+        return;
+    }
+    uint32_t start = DWT->CYCCNT;
+    ethernetif_csum_sw(p, c);
+    bench->sw_cycles += DWT->CYCCNT - start;
+    bench->frames++;
+}
+
+/* The engine over a received frame still in Rx buffer, the result is not used:
+   it stops reception while it runs, lwIP checks received frames itself */
+static void ethernetif_csum_bench_rx(struct pbuf *p) {
+    eth_csum_t c;
+    uint32_t start = DWT->CYCCNT;
+
+    if (!ethernetif_csum_parse(p, &c)) {
+        return;
+    }
+    (void)enc28j60_recv_checksum(SIZEOF_ETH_HDR, c.ip_hlen);
+    if (c.csum_pos) {
+        (void)enc28j60_recv_checksum(SIZEOF_ETH_HDR + c.ip_hlen, c.seg_len);
+    }
+    eth_csum_rx_bench.hw_cycles += DWT->CYCCNT - start;
+    ethernetif_csum_bench_sw(&eth_csum_rx_bench, p, &c);
+}
+#endif
+
+/* Let the ENC28J60 fill the checksums of the frame in its Tx slot */
+static void ethernetif_csum_tx(struct pbuf *p) {
+    eth_csum_t c;
+#if ETH_CHECKSUM_BENCH
+    uint32_t start = DWT->CYCCNT;
+#endif
+
+    if (!ethernetif_csum_parse(p, &c)) {
+        return;
+    }
+
+    u16_t seg = SIZEOF_ETH_HDR + c.ip_hlen;
+    enc28j60_send_checksum(SIZEOF_ETH_HDR, c.ip_hlen, SIZEOF_ETH_HDR + 10, 0);
+    if (c.csum_pos) {
+        enc28j60_send_checksum(seg, c.seg_len, seg + c.csum_pos, c.pseudo);
+    }
+
+#if ETH_CHECKSUM_BENCH
+    eth_csum_tx_bench.hw_cycles += DWT->CYCCNT - start;
+    ethernetif_csum_bench_sw(&eth_csum_tx_bench, p, &c);
+#endif
+}
+#endif
+
+/* frames waiting for a free ENC28J60 Tx slot */
+#define ETH_TXQ_SIZE 4
+static struct pbuf *eth_txq[ETH_TXQ_SIZE];
+static uint8_t eth_txq_head = 0;
+static uint8_t eth_txq_count = 0;
+
+static err_t low_level_send(struct pbuf *p) {
     struct pbuf *q;
-    /* Send the data from the pbuf to the interface, one pbuf at a
-       time. The size of the data in each pbuf is kept in the ->len
-       variable. */
+
+    if (enc28j60_send_begin() == ENC28J60_TX_BUSY) {
+        return ERR_WOULDBLOCK;
+    }
+
+    /* Gather the whole chain into one frame. The size of the data
+       in each pbuf is kept in the ->len variable. */
     for (q = p; q != NULL; q = q->next) {
-        /* Send the data from the pbuf to the interface */
-        enc28j60_send_packet(q->payload, q->len);
+        enc28j60_send_append(q->payload, q->len);
     }
+#if ETH_CHECKSUM_OFFLOAD
+    ethernetif_csum_tx(p);
+#endif
+    enc28j60_send_commit();
+
+    return ERR_OK;
+}
+
+static void ethernetif_output(struct netif *netif) {
+    (void)netif;
+
+    /* move finished Tx slots on, then refill them from the queue */
+    enc28j60_send_poll();
+    while (eth_txq_count > 0) {
+        struct pbuf *p = eth_txq[eth_txq_head];
+        if (low_level_send(p) != ERR_OK) {
+            break;
+        }
+        pbuf_free(p);
+        eth_txq_head = (eth_txq_head + 1) % ETH_TXQ_SIZE;
+        eth_txq_count--;
+    }
+}
+
+static err_t low_level_output(struct netif *netif, struct pbuf *p) {
+    if (p->tot_len > ENC28J60_TXMAXFRAME) {
+        return ERR_BUF;
+    }
+
+    /* keep frame order: the queue goes first */
+    ethernetif_output(netif);
+    if (eth_txq_count == 0 && low_level_send(p) == ERR_OK) {
+        return ERR_OK;
+    }
+
+    /* both Tx slots are busy, hold a reference until one is free */
+    if (eth_txq_count == ETH_TXQ_SIZE) {
+        return ERR_MEM;
+    }
+    pbuf_ref(p);
+    eth_txq[(eth_txq_head + eth_txq_count) % ETH_TXQ_SIZE] = p;
+    eth_txq_count++;
 
     return ERR_OK;
 }
@@ -78,7 +324,7 @@ static err_t low_level_output(struct netif *netif, struct pbuf *p) {
 static struct pbuf *low_level_input(struct netif *netif) {
     (void)netif;
 
-    u16_t len = enc28j60_recv_packet(pkt_buf, ENC28J60_MAXFRAME);
+    u16_t len = enc28j60_recv_begin();
     if (len == 0) {
         return NULL;
     }
@@ -87,13 +333,27 @@ static struct pbuf *low_level_input(struct netif *netif) {
     struct pbuf *p = NULL;
     p = pbuf_alloc(PBUF_RAW, len, PBUF_POOL);
     if (p != NULL) {
-        memcpy(p->payload, pkt_buf, len);
+        /* Stream the frame straight into each segment of the chain */
+        for (struct pbuf *q = p; q != NULL; q = q->next) {
+            enc28j60_recv_read(q->payload, q->len);
+        }
+#if ETH_CHECKSUM_OFFLOAD && ETH_CHECKSUM_BENCH
+        /* the frame is still in Rx buffer */
+        ethernetif_csum_bench_rx(p);
+#endif
     }
+
+    /* Frame is dropped if there is no pbuf for it */
+    enc28j60_recv_end();
     return p;
 }
 
 static void ethernetif_input(struct netif *netif) {
     struct pbuf *p;
+    /* skip the SPI poll until the INT line reports a packet */
+    if (!enc28j60_rx_pending()) {
+        return;
+    }
     /* move received packet into a new pbuf */
     while (p = low_level_input(netif)) {
         /* pass all packets to ethernet_input, which decides what packets it supports */
@@ -126,49 +386,120 @@ static void eth_init() {
     /* Set the default interface */
     netif_set_default(&eth0);
 
+    /* Follow address changes to tune the Rx filters */
+    netif_set_status_callback(&eth0, ethernetif_status_callback);
+
     /* When Link (HW) is up, process to set interface up */
     if (netif_is_link_up(&eth0)) {
         netif_set_up(&eth0);
     }
 
+#if ETH_CHECKSUM_OFFLOAD && ETH_CHECKSUM_BENCH
+    /* cycle counter */
+    CoreDebug->DEMCR |= CoreDebug_DEMCR_TRCENA_Msk;
+    DWT->CYCCNT = 0;
+    DWT->CTRL |= DWT_CTRL_CYCCNTENA_Msk;
+#endif
+
     /* Start DHCP negotiation */
     dhcp_start(&eth0);
 }
 
 typedef enum {
     TYPE_PING = 0,
-    TYPE_CARD = 1,
+    TYPE_CARD = 1,      /* 4-byte UID */
+    TYPE_CARD_LONG = 2, /* [LEN][UID], 7 or 10-byte UID */
+    TYPE_CARD_BATCH = 3, /* [N] then [LEN][UID] per card, every card of one sweep */
+    TYPE_CARD_DATA = 4,  /* [LEN][UID][N] then N blocks of 16 bytes, Classic sector or NTAG pages */
+    TYPE_EVENTS = 5,     /* [VER][N][SEQ][T0] then timed events of the types above, REPORT_BATCH in report.h */
 } send_type_t;
 
-static uint8_t card_buf[MF_BLOCK_SIZE + 2] = {0};
-static uint8_t data_buf[8] = {0};
-
-static void send_data(send_type_t type) {
-    data_buf[3] = type;
-    struct pbuf *pbuf = pbuf_alloc(PBUF_TRANSPORT, sizeof(data_buf), PBUF_RAM);
-    if (pbuf != NULL) {
-        memcpy(pbuf->payload, data_buf, sizeof(data_buf));
-        ip_addr_t dest_ip;
-        IP4_ADDR(&dest_ip, 255, 255, 255, 255);
-        struct udp_pcb *broadcast_udp_pcb = udp_new();
-        if (broadcast_udp_pcb != NULL) {
-            err_t err = udp_sendto(broadcast_udp_pcb, pbuf, &dest_ip, 12345);
-            if (err != ERR_OK) {
-                printf("udp_sendto err: %d\n", err);
-            }
-            udp_remove(broadcast_udp_pcb);
+#define DATA_LEN_BATCH (1 + READER_INVENTORY_MAX * 11)
+#define DATA_LEN_CARD  (1 + 10 + 1 + READER_DATA_BLOCKS * MF_BLOCK_SIZE)
+#if READER_CARD_DATA && REPORT_EVENTS_HLEN + 4 + DATA_LEN_CARD > REPORT_DATA_MAX
+#error "a card and its payload do not fit one report, lower READER_NTAG_PAGES or READER_READ_BLOCKS"
+#endif
+
+/* [ID0][ID1][ID2][type][payload] */
+static uint8_t data_buf[4 + (DATA_LEN_BATCH > DATA_LEN_CARD ? DATA_LEN_BATCH : DATA_LEN_CARD)] = {0};
+
+/* cards last reported, a sweep with the same cards is not sent again */
+static uint8_t last_uids[READER_INVENTORY_MAX][10];
+static uint8_t last_uid_lens[READER_INVENTORY_MAX];
+static uint8_t last_count = 0;
+
+static uint8_t sweep_is_new(const reader_sweep_t *sweep) {
+    if (sweep->count != last_count) {
+        return 1;
+    }
+    for (uint8_t i = 0; i < sweep->count; i++) {
+        const reader_card_t *card = &sweep->cards[i];
+        uint8_t seen = 0;
+        for (uint8_t j = 0; j < last_count && !seen; j++) {
+            seen = card->uid_len == last_uid_lens[j] && memcmp(card->uid, last_uids[j], card->uid_len) == 0;
+        }
+        if (!seen) {
+            return 1;
+        }
+    }
+    return 0;
+}
+
+static void send_data(send_type_t type, uint8_t len) {
+    report_event(type, &data_buf[4], len);
+}
+
+/* first 4 UID bytes for the log, built from bytes: uid has no alignment */
+static uint32_t card_uid32(const reader_card_t *card) {
+    return (uint32_t)card->uid[0] << 24 | (uint32_t)card->uid[1] << 16 | (uint32_t)card->uid[2] << 8 | card->uid[3];
+}
+
+#if READER_CARD_DATA
+/* Report each card of one sweep with its sector or NTAG payload */
+static void send_sweep(const reader_sweep_t *sweep) {
+    for (uint8_t i = 0; i < sweep->count; i++) {
+        const reader_card_t *card = &sweep->cards[i];
+        uint8_t len = 1 + card->uid_len;
+        LOG_EVENT2(LOG_EV_CARD_SENT, "SNDUID %08lX (%lu bytes)", card_uid32(card), card->uid_len);
+        data_buf[4] = card->uid_len;
+        memcpy(&data_buf[5], card->uid, card->uid_len);
+        data_buf[4 + len] = card->blocks;
+        memcpy(&data_buf[4 + len + 1], card->data, card->blocks * MF_BLOCK_SIZE);
+        len += 1 + card->blocks * MF_BLOCK_SIZE;
+        send_data(TYPE_CARD_DATA, len);
+    }
+}
+#else
+/* Report the cards of one sweep in one message, a card leaving the field is not reported */
+static void send_sweep(const reader_sweep_t *sweep) {
+    if (sweep->count == 1) {
+        const reader_card_t *card = &sweep->cards[0];
+        LOG_EVENT2(LOG_EV_CARD_SENT, "SNDUID %08lX (%lu bytes)", card_uid32(card), card->uid_len);
+        if (card->uid_len == 4) {
+            memcpy(&data_buf[4], card->uid, 4);
+            send_data(TYPE_CARD, 4);
         } else {
-            printf("upd_new failed\n");
+            data_buf[4] = card->uid_len;
+            memcpy(&data_buf[5], card->uid, card->uid_len);
+            send_data(TYPE_CARD_LONG, 1 + card->uid_len);
         }
-        pbuf_free(pbuf);
-    } else {
-        printf("pbuf_alloc failed\n");
+    } else if (sweep->count > 1) {
+        uint8_t len = 1;
+        data_buf[4] = sweep->count;
+        for (uint8_t i = 0; i < sweep->count; i++) {
+            data_buf[4 + len] = sweep->cards[i].uid_len;
+            memcpy(&data_buf[4 + len + 1], sweep->cards[i].uid, sweep->cards[i].uid_len);
+            len += 1 + sweep->cards[i].uid_len;
+        }
+        LOG_EVENT1(LOG_EV_CARDS_SENT, "SNDUID batch of %lu", sweep->count);
+        send_data(TYPE_CARD_BATCH, len);
     }
 }
+#endif
 
 __attribute__((noreturn)) void app_main(void) {
     setbuf(stdout, NULL);
-    printf("\n");
+    LOG_EVENT0(LOG_EV_BOOT, "\nBOOT");
 
     LL_SYSTICK_EnableIT();
 
@@ -189,31 +520,36 @@ __attribute__((noreturn)) void app_main(void) {
 
     lwip_init();
     eth_init();
+    report_init(data_buf);
     mfrc522_init();
 
     uint32_t last_ping_tick = sys_now();
     uint32_t last_rfid_tick = sys_now();
+    uint32_t last_sweeps = 0;
+    uint32_t last_tags = 0;
+    uint32_t last_field_ms = 0;
+    uint32_t last_rfid_spi = 0;
+    uint32_t last_card_ms = 0;
     while (1) {
-        /* read RFID Card */
-        uint8_t status = mfrc522_request(PICC_REQIDL, card_buf);
-        if (status == MI_OK) {
-            status = mfrc522_anti_collision(card_buf);
-            if (status == MI_OK) {
-                // uchar size = mfrc522_select_tag(card_buf);
-                // mfrc522_halt();
-                if (htonl(*(uint32_t *)card_buf) != htonl(*(uint32_t *)&data_buf[4])) {
-                    data_buf[4] = card_buf[0];
-                    data_buf[5] = card_buf[1];
-                    data_buf[6] = card_buf[2];
-                    data_buf[7] = card_buf[3];
-                    printf("SNDUID\n");
-                    send_data(TYPE_CARD);
+        /* read RFID Card, one short step per pass so Ethernet is never kept waiting */
+        if (reader_poll() == READER_SWEEP) {
+            const reader_sweep_t *sweep = reader_sweep();
+            if (sweep_is_new(sweep)) {
+                for (uint8_t i = 0; i < sweep->count; i++) {
+                    memcpy(last_uids[i], sweep->cards[i].uid, sweep->cards[i].uid_len);
+                    last_uid_lens[i] = sweep->cards[i].uid_len;
                 }
+                last_count = sweep->count;
+                send_sweep(sweep);
             }
         }
 
+        /* send the batch of events once its time is up */
+        report_poll();
+
         /* read Ethernet packets */
         ethernetif_input(&eth0);
+        ethernetif_output(&eth0);
         sys_check_timeouts();
 
         /* internal routines */
@@ -222,14 +558,70 @@ __attribute__((noreturn)) void app_main(void) {
             data_buf[5] = 0xFF;
             data_buf[6] = 0xFF;
             data_buf[7] = 0xFF;
-            printf("SNDALV\n");
-            send_data(TYPE_PING);
+            LOG_EVENT0(LOG_EV_ALIVE_SENT, "SNDALV");
+            send_data(TYPE_PING, 4);
+            const enc28j60_stats_t *eth_stats = enc28j60_get_stats();
+            uint32_t eth_frames = eth_stats->rx + eth_stats->tx;
+            LOG_EVENT1(LOG_EV_SPI_FRAME, "SPI = %lu/frame", eth_frames ? eth_stats->spi / eth_frames : 0);
+            const reader_stats_t *rfid_stats = reader_get_stats();
+            uint32_t rfid_ms = sys_now() - last_ping_tick;
+            LOG_EVENT2(LOG_EV_RFID_RATE, "RFID = %lu sweeps/s, %lu tags/s",
+                       (rfid_stats->sweeps - last_sweeps) * 1000 / rfid_ms,
+                       (rfid_stats->tags - last_tags) * 1000 / rfid_ms);
+            /* antenna duty and SPI traffic, what LPCD saves while the field is empty */
+            uint32_t rfid_spi = mfrc522_get_stats()->spi;
+            LOG_EVENT2(LOG_EV_RFID_POWER, "RFID = field %lu%%, SPI %lu/s",
+                       (rfid_stats->field_ms - last_field_ms) * 100 / rfid_ms,
+                       (rfid_spi - last_rfid_spi) * 1000 / rfid_ms);
+            if (rfid_stats->tags != last_tags) {
+                LOG_EVENT2(LOG_EV_CARD_TIME, "card = %lu ms avg, %lu ms max",
+                           (rfid_stats->card_ms - last_card_ms) / (rfid_stats->tags - last_tags),
+                           rfid_stats->card_max);
+            }
+            last_sweeps = rfid_stats->sweeps;
+            last_tags = rfid_stats->tags;
+            last_card_ms = rfid_stats->card_ms;
+            last_field_ms = rfid_stats->field_ms;
+            last_rfid_spi = rfid_spi;
+            if (logger_dropped()) {
+                LOG_EVENT1(LOG_EV_LOG_DROPPED, "LOG dropped = %lu writes", logger_dropped());
+            }
+            /* the send path allocates nothing, the peak must stay put once running */
+            uint32_t heap_used, heap_peak;
+            report_heap(&heap_used, &heap_peak);
+            LOG_EVENT2(LOG_EV_HEAP, "HEAP = %lu used, %lu peak", heap_used, heap_peak);
+            /* batches sent again or given up on, the collector's ACKs did not come back */
+            const report_stats_t *report_stats = report_get_stats();
+            if (report_stats->retries || report_stats->lost) {
+                LOG_EVENT2(LOG_EV_REPORT_RTX, "REPORT = %lu retries, %lu lost",
+                           report_stats->retries, report_stats->lost);
+            }
+#if MEM_STATS && MEMP_STATS
+            /* peaks to size MEM_SIZE and PBUF_POOL_SIZE in lwipopts.h */
+            LOG_EVENT2(LOG_EV_LWIP_MEM, "lwIP heap = %lu peak of %lu",
+                       (uint32_t)lwip_stats.mem.max, (uint32_t)lwip_stats.mem.avail);
+            LOG_EVENT2(LOG_EV_LWIP_POOL, "PBUF_POOL = %lu peak of %lu",
+                       (uint32_t)lwip_stats.memp[MEMP_PBUF_POOL]->max,
+                       (uint32_t)lwip_stats.memp[MEMP_PBUF_POOL]->avail);
+#endif
+#if ETH_CHECKSUM_OFFLOAD && ETH_CHECKSUM_BENCH
+            if (eth_csum_tx_bench.frames) {
+                LOG_EVENT2(LOG_EV_CSUM_TX, "CSUM Tx = hw %lu / sw %lu cycles/frame",
+                           eth_csum_tx_bench.hw_cycles / eth_csum_tx_bench.frames,
+                           eth_csum_tx_bench.sw_cycles / eth_csum_tx_bench.frames);
+            }
+            if (eth_csum_rx_bench.frames) {
+                LOG_EVENT2(LOG_EV_CSUM_RX, "CSUM Rx = hw %lu / sw %lu cycles/frame",
+                           eth_csum_rx_bench.hw_cycles / eth_csum_rx_bench.frames,
+                           eth_csum_rx_bench.sw_cycles / eth_csum_rx_bench.frames);
+            }
+#endif
             last_ping_tick = sys_now();
         }
 
         if (sys_now() - last_rfid_tick >= 3000) {
-            data_buf[4] = data_buf[5] = data_buf[6] = data_buf[7] = 0;
-            printf("CLRUID\n");
+            last_count = 0;
+            LOG_EVENT0(LOG_EV_CARD_CLEAR, "CLRUID");
             last_rfid_tick = sys_now();
         }
     }
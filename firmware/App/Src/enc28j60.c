@@ -1,14 +1,52 @@
 #include "enc28j60.h"
 #include "main.h"
 
-#define enc28j60_select()  ETH_NSS_GPIO_Port->BSRR = GPIO_BSRR_BR12
+#define enc28j60_select()                         \
+    do {                                          \
+        enc28j60_dma_wait();                      \
+        enc28j60_stats.spi++;                     \
+        ETH_NSS_GPIO_Port->BSRR = GPIO_BSRR_BR12; \
+    } while (0)
 #define enc28j60_release() ETH_NSS_GPIO_Port->BSRR = GPIO_BSRR_BS12
 #define enc28j60_rx()      enc28j60_spi_rw(0x00)
 #define enc28j60_tx(data)  enc28j60_spi_rw(data)
 
+#define enc28j60_txslot_start(slot) (ENC28J60_TXSTART + (slot) * ENC28J60_TXSLOT)
+
+// SPI2 DMA requests are hard-wired to DMA1 channel 4 (Rx) and 5 (Tx)
+#define ENC28J60_DMA_RX_CH LL_DMA_CHANNEL_4
+#define ENC28J60_DMA_TX_CH LL_DMA_CHANNEL_5
+
+static enc28j60_stats_t enc28j60_stats = {0};
+static volatile uint8_t enc28j60_dma_active = 0;
+static uint8_t enc28j60_dma_hold = 0; // keep CS low after the burst
+static enc28j60_dma_cb_t enc28j60_dma_cb = 0;
+static uint8_t enc28j60_dma_dummy = 0;
+
+// Wait until a pending DMA burst has released the bus
+static void enc28j60_dma_wait() {
+    while (enc28j60_dma_active)
+        ;
+}
+
+static void enc28j60_dma_init() {
+    LL_AHB1_GRP1_EnableClock(LL_AHB1_GRP1_PERIPH_DMA1);
+
+    LL_DMA_SetPeriphAddress(DMA1, ENC28J60_DMA_RX_CH, LL_SPI_DMA_GetRegAddr(SPI2));
+    LL_DMA_SetPeriphAddress(DMA1, ENC28J60_DMA_TX_CH, LL_SPI_DMA_GetRegAddr(SPI2));
+
+    // Rx channel completes last, so only it raises the interrupt
+    LL_DMA_EnableIT_TC(DMA1, ENC28J60_DMA_RX_CH);
+    LL_DMA_EnableIT_TE(DMA1, ENC28J60_DMA_RX_CH);
+
+    NVIC_SetPriority(DMA1_Channel4_IRQn, NVIC_EncodePriority(NVIC_GetPriorityGrouping(), 5, 0));
+    NVIC_EnableIRQ(DMA1_Channel4_IRQn);
+}
+
 static void enc28j60_spi_init() {
     LL_SPI_Enable(SPI2);
     enc28j60_release();
+    enc28j60_dma_init();
 }
 
 static uint8_t enc28j60_spi_rw(uint8_t data) {
@@ -27,6 +65,14 @@ static void enc28j60_delay(uint32_t ms) {
 
 static uint8_t enc28j60_current_bank = 0;
 static uint16_t enc28j60_rxrdpt = 0;
+static uint16_t enc28j60_rxframe = 0;        // first byte of current Rx packet
+static uint16_t enc28j60_txlen = 0;
+static uint8_t enc28j60_txload = 0;          // slot being loaded
+static int8_t enc28j60_txsending = -1;       // slot on the wire
+static int8_t enc28j60_txqueued = -1;        // slot loaded and waiting for the wire
+static uint16_t enc28j60_txend[ENC28J60_TXSLOTS];
+static volatile uint8_t enc28j60_irq_flag = 0;
+static uint8_t enc28j60_hash_refs[64]; // multicast groups per hash table bit
 
 // Generic SPI read command
 uint8_t enc28j60_read_op(uint8_t cmd, uint8_t adr) {
@@ -65,18 +111,33 @@ void enc28j60_soft_reset() {
 
 // Set register bank
 void enc28j60_set_bank(uint8_t adr) {
-    uint8_t bank;
+    uint8_t bank, mask;
 
     if ((adr & ENC28J60_ADDR_MASK) < ENC28J60_COMMON_CR) {
         bank = (adr >> 5) & ENC28J60_BANK_MASK;
         if (bank != enc28j60_current_bank) {
-            enc28j60_write_op(ENC28J60_SPI_BFC, ECON1, ENC28J60_BANK_MASK);
-            enc28j60_write_op(ENC28J60_SPI_BFS, ECON1, bank);
+            // Only touch the BSEL bits that change, often a single op
+            mask = enc28j60_current_bank & ~bank;
+            if (mask)
+                enc28j60_write_op(ENC28J60_SPI_BFC, ECON1, mask);
+            mask = bank & ~enc28j60_current_bank;
+            if (mask)
+                enc28j60_write_op(ENC28J60_SPI_BFS, ECON1, mask);
             enc28j60_current_bank = bank;
         }
     }
 }
 
+// Run a table of WCR/BFS/BFC ops in order, switching bank only when it changes.
+// Keep the table grouped by bank to get the fewest switches.
+void enc28j60_program(const enc28j60_op_t *ops, uint8_t count) {
+    while (count--) {
+        enc28j60_set_bank(ops->adr);
+        enc28j60_write_op(ops->cmd, ops->adr, ops->val);
+        ops++;
+    }
+}
+
 // Read register
 uint8_t enc28j60_rcr(uint8_t adr) {
     enc28j60_set_bank(adr);
@@ -133,8 +194,95 @@ void enc28j60_bfs_mac_mii(uint8_t adr, uint8_t mask) {
     enc28j60_write_op(ENC28J60_SPI_WCR, adr, data);
 }
 
+// Stream a full-duplex DMA burst inside an already selected transaction.
+// Rx buffer or Tx buffer can be NULL, the dummy byte is used instead.
+static void enc28j60_dma_stream(uint8_t *rxbuf, const uint8_t *txbuf, uint16_t len, enc28j60_dma_cb_t cb) {
+    enc28j60_dma_cb = cb;
+    enc28j60_dma_active = 1;
+
+    LL_DMA_ConfigTransfer(DMA1, ENC28J60_DMA_RX_CH,
+                          LL_DMA_DIRECTION_PERIPH_TO_MEMORY | LL_DMA_PRIORITY_VERYHIGH | LL_DMA_MODE_NORMAL |
+                              LL_DMA_PERIPH_NOINCREMENT | (rxbuf ? LL_DMA_MEMORY_INCREMENT : LL_DMA_MEMORY_NOINCREMENT) |
+                              LL_DMA_PDATAALIGN_BYTE | LL_DMA_MDATAALIGN_BYTE);
+    LL_DMA_SetMemoryAddress(DMA1, ENC28J60_DMA_RX_CH, (uint32_t)(rxbuf ? rxbuf : &enc28j60_dma_dummy));
+    LL_DMA_SetDataLength(DMA1, ENC28J60_DMA_RX_CH, len);
+
+    LL_DMA_ConfigTransfer(DMA1, ENC28J60_DMA_TX_CH,
+                          LL_DMA_DIRECTION_MEMORY_TO_PERIPH | LL_DMA_PRIORITY_HIGH | LL_DMA_MODE_NORMAL |
+                              LL_DMA_PERIPH_NOINCREMENT | (txbuf ? LL_DMA_MEMORY_INCREMENT : LL_DMA_MEMORY_NOINCREMENT) |
+                              LL_DMA_PDATAALIGN_BYTE | LL_DMA_MDATAALIGN_BYTE);
+    LL_DMA_SetMemoryAddress(DMA1, ENC28J60_DMA_TX_CH, (uint32_t)(txbuf ? txbuf : &enc28j60_dma_dummy));
+    LL_DMA_SetDataLength(DMA1, ENC28J60_DMA_TX_CH, len);
+
+    // Rx must be armed before Tx starts clocking
+    LL_DMA_EnableChannel(DMA1, ENC28J60_DMA_RX_CH);
+    LL_SPI_EnableDMAReq_RX(SPI2);
+    LL_DMA_EnableChannel(DMA1, ENC28J60_DMA_TX_CH);
+    LL_SPI_EnableDMAReq_TX(SPI2);
+}
+
+// Start a DMA burst after the RBM/WBM opcode.
+// The opcode is clocked out by the CPU, then DMA streams the payload.
+static void enc28j60_dma_start(uint8_t cmd, uint8_t *rxbuf, const uint8_t *txbuf, uint16_t len, enc28j60_dma_cb_t cb) {
+    enc28j60_select();
+    enc28j60_tx(cmd);
+    enc28j60_dma_stream(rxbuf, txbuf, len, cb);
+}
+
+// DMA1 channel 4 interrupt: Rx complete means the last byte is clocked in
+void enc28j60_dma_irq(void) {
+    if (!LL_DMA_IsActiveFlag_TC4(DMA1) && !LL_DMA_IsActiveFlag_TE4(DMA1))
+        return;
+
+    LL_DMA_ClearFlag_GI4(DMA1);
+    LL_DMA_ClearFlag_GI5(DMA1);
+    LL_SPI_DisableDMAReq_TX(SPI2);
+    LL_SPI_DisableDMAReq_RX(SPI2);
+    LL_DMA_DisableChannel(DMA1, ENC28J60_DMA_TX_CH);
+    LL_DMA_DisableChannel(DMA1, ENC28J60_DMA_RX_CH);
+
+    if (!enc28j60_dma_hold) {
+        enc28j60_release();
+    }
+    enc28j60_dma_active = 0;
+
+    if (enc28j60_dma_cb) {
+        enc28j60_dma_cb();
+    }
+}
+
+uint8_t enc28j60_dma_busy(void) {
+    return enc28j60_dma_active;
+}
+
+// Read Rx/Tx buffer (at ERDPT) in background, cb is called from interrupt
+void enc28j60_read_buffer_dma(uint8_t *buf, uint16_t len, enc28j60_dma_cb_t cb) {
+    if (len == 0) {
+        if (cb)
+            cb();
+        return;
+    }
+    enc28j60_dma_start(ENC28J60_SPI_RBM, buf, 0, len, cb);
+}
+
+// Write Rx/Tx buffer (at EWRPT) in background, cb is called from interrupt
+void enc28j60_write_buffer_dma(const uint8_t *buf, uint16_t len, enc28j60_dma_cb_t cb) {
+    if (len == 0) {
+        if (cb)
+            cb();
+        return;
+    }
+    enc28j60_dma_start(ENC28J60_SPI_WBM, 0, buf, len, cb);
+}
+
 // Read Rx/Tx buffer (at ERDPT)
 void enc28j60_read_buffer(uint8_t *buf, uint16_t len) {
+    if (len >= ENC28J60_DMA_MINLEN) {
+        enc28j60_read_buffer_dma(buf, len, 0);
+        enc28j60_dma_wait();
+        return;
+    }
+
     enc28j60_select();
     enc28j60_tx(ENC28J60_SPI_RBM);
     while (len--)
@@ -144,6 +292,12 @@ void enc28j60_read_buffer(uint8_t *buf, uint16_t len) {
 
 // Write Rx/Tx buffer (at EWRPT)
 void enc28j60_write_buffer(uint8_t *buf, uint16_t len) {
+    if (len >= ENC28J60_DMA_MINLEN) {
+        enc28j60_write_buffer_dma(buf, len, 0);
+        enc28j60_dma_wait();
+        return;
+    }
+
     enc28j60_select();
     enc28j60_tx(ENC28J60_SPI_WBM);
     while (len--)
@@ -176,34 +330,46 @@ void enc28j60_write_phy(uint8_t adr, uint16_t data) {
  */
 
 void enc28j60_init(uint8_t *macadr) {
+    const enc28j60_op_t setup_ops[] = {
+        // Setup Rx/Tx buffer
+        ENC28J60_WCR16(ERXST, ENC28J60_RXSTART),
+        ENC28J60_WCR16(ERXRDPT, ENC28J60_RXSTART),
+        ENC28J60_WCR16(ERXND, ENC28J60_RXEND),
+
+        // Setup MAC
+        ENC28J60_WCR(MACON1, MACON1_TXPAUS |                                      // Enable flow control
+                                 MACON1_RXPAUS | MACON1_MARXEN),                  // Enable MAC Rx
+        ENC28J60_WCR(MACON2, 0),                                                  // Clear reset
+        ENC28J60_WCR(MACON3, MACON3_PADCFG0 |                                     // Enable padding,
+                                 MACON3_TXCRCEN | MACON3_FRMLNEN | MACON3_FULDPX), // Enable crc & frame len chk
+        ENC28J60_WCR16(MAMXFL, ENC28J60_MAXFRAME),
+        ENC28J60_WCR(MABBIPG, 0x15), // Set inter-frame gap
+        ENC28J60_WCR(MAIPGL, 0x12),
+        ENC28J60_WCR(MAIPGH, 0x0c),
+        ENC28J60_WCR(MAADR1, macadr[0]), // Set MAC address
+        ENC28J60_WCR(MAADR2, macadr[1]),
+        ENC28J60_WCR(MAADR3, macadr[2]),
+        ENC28J60_WCR(MAADR4, macadr[3]),
+        ENC28J60_WCR(MAADR5, macadr[4]),
+        ENC28J60_WCR(MAADR6, macadr[5]),
+    };
+
+    const enc28j60_op_t start_ops[] = {
+#if ENC28J60_RX_IRQ
+        ENC28J60_BFS(EIE, EIE_INTIE | EIE_PKTIE), // Assert INT while there are packets in Rx buffer
+#endif
+        ENC28J60_BFC(EIR, EIR_TXIF | EIR_TXERIF), // Tx completion is polled from EIR
+        ENC28J60_BFS(ECON1, ECON1_RXEN),          // Enable Rx packets
+    };
+
     enc28j60_spi_init();
 
     // Reset ENC28J60
     enc28j60_soft_reset();
 
-    // Setup Rx/Tx buffer
-    enc28j60_wcr16(ERXST, ENC28J60_RXSTART);
-    enc28j60_wcr16(ERXRDPT, ENC28J60_RXSTART);
-    enc28j60_wcr16(ERXND, ENC28J60_RXEND);
+    enc28j60_program(setup_ops, sizeof(setup_ops) / sizeof(setup_ops[0]));
     enc28j60_rxrdpt = ENC28J60_RXSTART;
 
-    // Setup MAC
-    enc28j60_wcr(MACON1, MACON1_TXPAUS |                                       // Enable flow control
-                             MACON1_RXPAUS | MACON1_MARXEN);                   // Enable MAC Rx
-    enc28j60_wcr(MACON2, 0);                                                   // Clear reset
-    enc28j60_wcr(MACON3, MACON3_PADCFG0 |                                      // Enable padding,
-                             MACON3_TXCRCEN | MACON3_FRMLNEN | MACON3_FULDPX); // Enable crc & frame len chk
-    enc28j60_wcr16(MAMXFL, ENC28J60_MAXFRAME);
-    enc28j60_wcr(MABBIPG, 0x15); // Set inter-frame gap
-    enc28j60_wcr(MAIPGL, 0x12);
-    enc28j60_wcr(MAIPGH, 0x0c);
-    enc28j60_wcr(MAADR1, macadr[0]); // Set MAC address
-    enc28j60_wcr(MAADR2, macadr[1]);
-    enc28j60_wcr(MAADR3, macadr[2]);
-    enc28j60_wcr(MAADR4, macadr[3]);
-    enc28j60_wcr(MAADR5, macadr[4]);
-    enc28j60_wcr(MAADR6, macadr[5]);
-
     // Setup PHY
     enc28j60_write_phy(PHCON1, PHCON1_PDPXMD); // Force full-duplex mode
     enc28j60_write_phy(PHCON2, PHCON2_HDLDIS); // Disable loopback
@@ -211,55 +377,369 @@ void enc28j60_init(uint8_t *macadr) {
                                    PHLCON_LBCFG2 | PHLCON_LBCFG1 | PHLCON_LBCFG0 |
                                    PHLCON_LFRQ0 | PHLCON_STRCH);
 
-    // Enable Rx packets
-    enc28j60_bfs(ECON1, ECON1_RXEN);
+#if ENC28J60_RX_IRQ
+    NVIC_SetPriority(EXTI9_5_IRQn, NVIC_EncodePriority(NVIC_GetPriorityGrouping(), 6, 0));
+    NVIC_EnableIRQ(EXTI9_5_IRQn);
+#endif
+
+    enc28j60_program(start_ops, sizeof(start_ops) / sizeof(start_ops[0]));
+}
+
+// INT line falling edge (EXTI8), leave the work to the main loop
+void enc28j60_irq(void) {
+    enc28j60_irq_flag = 1;
+}
+
+// SPI transaction and frame counters since init
+const enc28j60_stats_t *enc28j60_get_stats(void) {
+    return &enc28j60_stats;
+}
+
+// Check if Rx buffer may hold packets, without touching SPI in IRQ mode
+uint8_t enc28j60_rx_pending(void) {
+#if ENC28J60_RX_IRQ
+    // INT stays low until EPKTCNT drops to zero, so the pin level
+    // also catches an edge that came while the flag was being cleared
+    if (enc28j60_irq_flag || !LL_GPIO_IsInputPinSet(ETH_IRQ_GPIO_Port, ETH_IRQ_Pin)) {
+        enc28j60_irq_flag = 0;
+        return 1;
+    }
+    return 0;
+#else
+    return 1;
+#endif
+}
+
+// Put a loaded slot on the wire
+static void enc28j60_send_start(uint8_t slot) {
+    const enc28j60_op_t ops[] = {
+        ENC28J60_WCR16(ETXST, enc28j60_txslot_start(slot)),
+        ENC28J60_WCR16(ETXND, enc28j60_txend[slot]),
+        ENC28J60_BFS(ECON1, ECON1_TXRTS), // Request packet send
+    };
+
+    enc28j60_program(ops, sizeof(ops) / sizeof(ops[0]));
+    enc28j60_txsending = slot;
+    enc28j60_stats.tx++;
 }
 
-void enc28j60_send_packet(uint8_t *data, uint16_t len) {
-    while (enc28j60_rcr(ECON1) & ECON1_TXRTS) {
+// Check the frame on the wire, start the queued one when it is done
+void enc28j60_send_poll(void) {
+    uint8_t eir;
+
+    if (enc28j60_txsending < 0)
+        return;
+
+    eir = enc28j60_rcr(EIR);
+    if (!(eir & (EIR_TXIF | EIR_TXERIF)))
+        return; // still on the wire
+
+    if (eir & EIR_TXERIF) {
         // TXRTS may not clear - ENC28J60 bug. We must reset
-        // transmit logic in cause of Tx error
-        if (enc28j60_rcr(EIR) & EIR_TXERIF) {
-            enc28j60_bfs(ECON1, ECON1_TXRST);
-            enc28j60_bfc(ECON1, ECON1_TXRST);
-        }
+        // transmit logic in cause of Tx error, the frame is lost
+        enc28j60_bfs(ECON1, ECON1_TXRST);
+        enc28j60_bfc(ECON1, ECON1_TXRST);
+        enc28j60_bfc(ECON1, ECON1_TXRTS);
+    }
+    enc28j60_bfc(EIR, EIR_TXIF | EIR_TXERIF);
+    enc28j60_txsending = -1;
+
+    if (enc28j60_txqueued >= 0) {
+        enc28j60_send_start(enc28j60_txqueued);
+        enc28j60_txqueued = -1;
+    }
+}
+
+// Start a new Tx frame in a free slot, all appended data goes out in one WBM burst
+uint8_t enc28j60_send_begin(void) {
+    if (enc28j60_txqueued >= 0) {
+        enc28j60_send_poll();
+        if (enc28j60_txqueued >= 0)
+            return ENC28J60_TX_BUSY;
     }
 
-    enc28j60_wcr16(EWRPT, ENC28J60_TXSTART);
-    enc28j60_write_buffer((uint8_t *)"\x00", 1);
-    enc28j60_write_buffer(data, len);
+    enc28j60_txload = (enc28j60_txsending == 0) ? 1 : 0;
+    enc28j60_wcr16(EWRPT, enc28j60_txslot_start(enc28j60_txload));
 
-    enc28j60_wcr16(ETXST, ENC28J60_TXSTART);
-    enc28j60_wcr16(ETXND, ENC28J60_TXSTART + len);
+    // CS stays low until commit
+    enc28j60_select();
+    enc28j60_tx(ENC28J60_SPI_WBM);
+    enc28j60_tx(0x00); // Per-packet control byte: use MACON3 settings
+    enc28j60_dma_hold = 1;
+    enc28j60_txlen = 0;
 
-    enc28j60_bfs(ECON1, ECON1_TXRTS); // Request packet send
+    return ENC28J60_TX_SENDING;
 }
 
-uint16_t enc28j60_recv_packet(uint8_t *buf, uint16_t buflen) {
-    uint16_t len = 0, rxlen, status, temp;
+// Append data to current Tx frame, data must stay valid until commit
+void enc28j60_send_append(const uint8_t *data, uint16_t len) {
+    // Never run past Tx slot
+    if (len > ENC28J60_TXMAXFRAME - enc28j60_txlen)
+        len = ENC28J60_TXMAXFRAME - enc28j60_txlen;
+
+    enc28j60_dma_wait();
+    if (len >= ENC28J60_DMA_MINLEN) {
+        enc28j60_dma_stream(0, data, len, 0);
+    } else {
+        for (uint16_t i = 0; i < len; i++)
+            enc28j60_tx(data[i]);
+    }
+    enc28j60_txlen += len;
+}
 
-    if (enc28j60_rcr(EPKTCNT)) {
+// Run the DMA checksum engine over buffer memory [start, end], it wraps at the
+// end of Rx buffer by itself. Return the ones' complement sum, not inverted.
+static uint16_t enc28j60_dma_checksum(uint16_t start, uint16_t end) {
+    // Errata: a packet received while the engine runs can corrupt the result,
+    // so hold Rx off for the few microseconds it takes
+    enc28j60_bfc(ECON1, ECON1_RXEN);
+    while (enc28j60_rcr(ESTAT) & ESTAT_RXBUSY)
+        ;
+
+    const enc28j60_op_t ops[] = {
+        ENC28J60_WCR16(EDMAST, start),
+        ENC28J60_WCR16(EDMAND, end),
+        ENC28J60_BFS(ECON1, ECON1_CSUMEN | ECON1_DMAST),
+    };
+    enc28j60_program(ops, sizeof(ops) / sizeof(ops[0]));
+    while (enc28j60_rcr(ECON1) & ECON1_DMAST)
+        ;
+    uint16_t sum = ~enc28j60_rcr16(EDMACS); // EDMACSH is the first byte on the wire
+
+    const enc28j60_op_t done_ops[] = {
+        ENC28J60_BFC(ECON1, ECON1_CSUMEN),
+        ENC28J60_BFS(ECON1, ECON1_RXEN),
+    };
+    enc28j60_program(done_ops, sizeof(done_ops) / sizeof(done_ops[0]));
+
+    return sum;
+}
+
+// End the WBM burst opened by send_begin
+static void enc28j60_send_flush(void) {
+    if (!enc28j60_dma_hold)
+        return;
+    enc28j60_dma_wait();
+    enc28j60_dma_hold = 0;
+    enc28j60_release();
+}
+
+// Compute the Internet checksum of frame bytes [start, start + len) in the slot
+// being loaded, add seed (e.g. a pseudo header sum) and store the result
+// big-endian at frame offset pos. The checksum field must be zero in the frame.
+// Call after the last append, before commit.
+void enc28j60_send_checksum(uint16_t start, uint16_t len, uint16_t pos, uint16_t seed) {
+    uint16_t base = enc28j60_txslot_start(enc28j60_txload) + 1; // skip control byte
+    uint32_t sum;
+
+    if (len == 0 || start + len > enc28j60_txlen || pos + 2 > enc28j60_txlen)
+        return;
+
+    enc28j60_send_flush();
+
+    sum = enc28j60_dma_checksum(base + start, base + start + len - 1) + seed;
+    sum = (sum & 0xFFFF) + (sum >> 16);
+    sum = (uint16_t)~sum;
+    if (sum == 0)
+        sum = 0xFFFF; // zero means "no checksum" for UDP, the same value for the others
+
+    enc28j60_wcr16(EWRPT, base + pos);
+    enc28j60_select();
+    enc28j60_tx(ENC28J60_SPI_WBM);
+    enc28j60_tx(sum >> 8);
+    enc28j60_tx(sum);
+    enc28j60_release();
+}
+
+// Close the WBM burst, send the frame now or queue it behind the one on the wire
+uint8_t enc28j60_send_commit(void) {
+    enc28j60_send_flush();
+
+    enc28j60_txend[enc28j60_txload] = enc28j60_txslot_start(enc28j60_txload) + enc28j60_txlen;
+
+    // The previous frame may have finished while this one was loading
+    enc28j60_send_poll();
+    if (enc28j60_txsending >= 0) {
+        enc28j60_txqueued = enc28j60_txload;
+        return ENC28J60_TX_QUEUED;
+    }
+
+    enc28j60_send_start(enc28j60_txload);
+    return ENC28J60_TX_SENDING;
+}
+
+uint8_t enc28j60_send_packet(uint8_t *data, uint16_t len) {
+    if (enc28j60_send_begin() == ENC28J60_TX_BUSY)
+        return ENC28J60_TX_BUSY;
+    enc28j60_send_append(data, len);
+    return enc28j60_send_commit();
+}
+
+// Start reading the next packet, return its length (without CRC) or 0 if there is none.
+// Frames with bad status are dropped here.
+uint16_t enc28j60_recv_begin(void) {
+    uint8_t header[6]; // next packet pointer, byte count, status
+    uint16_t rxlen, status;
+
+    while (enc28j60_rcr(EPKTCNT)) {
         enc28j60_wcr16(ERDPT, enc28j60_rxrdpt);
+        enc28j60_rxframe = enc28j60_rxrdpt + sizeof(header);
+        if (enc28j60_rxframe > ENC28J60_RXEND)
+            enc28j60_rxframe -= ENC28J60_RXSIZE;
 
-        enc28j60_read_buffer((void *)&enc28j60_rxrdpt, sizeof(enc28j60_rxrdpt));
-        enc28j60_read_buffer((void *)&rxlen, sizeof(rxlen));
-        enc28j60_read_buffer((void *)&status, sizeof(status));
+        // Whole header in one RBM transaction
+        enc28j60_read_buffer(header, sizeof(header));
+        enc28j60_rxrdpt = header[0] | (header[1] << 8);
+        rxlen = header[2] | (header[3] << 8);
+        status = header[4] | (header[5] << 8);
 
         if (status & 0x80) // success
         {
-            len = rxlen - 4; // throw out crc
-            if (len > buflen)
-                len = buflen;
-            enc28j60_read_buffer(buf, len);
+            enc28j60_stats.rx++;
+            return rxlen - 4; // throw out crc
         }
 
-        // Set Rx read pointer to next packet
-        temp = (enc28j60_rxrdpt - 1) & ENC28J60_BUFEND;
-        enc28j60_wcr16(ERXRDPT, temp);
+        enc28j60_recv_end();
+    }
+
+    return 0;
+}
 
-        // Decrement packet counter
-        enc28j60_bfs(ECON2, ECON2_PKTDEC);
+// Read the next part of current packet, ERDPT wraps around Rx buffer by itself
+void enc28j60_recv_read(uint8_t *buf, uint16_t len) {
+    enc28j60_read_buffer(buf, len);
+}
+
+// Ones' complement sum (not inverted) of bytes [start, start + len) of current
+// packet, computed by the DMA checksum engine in Rx buffer. Reception is off while
+// the engine runs, so frames arriving then are lost: for measurements, not for
+// checking every frame.
+uint16_t enc28j60_recv_checksum(uint16_t start, uint16_t len) {
+    uint16_t first = enc28j60_rxframe + start;
+    uint16_t last;
+
+    if (len == 0)
+        return 0;
+
+    if (first > ENC28J60_RXEND)
+        first -= ENC28J60_RXSIZE;
+    last = first + len - 1;
+    if (last > ENC28J60_RXEND)
+        last -= ENC28J60_RXSIZE;
+
+    return enc28j60_dma_checksum(first, last);
+}
+
+// Release current packet, any unread part is discarded
+void enc28j60_recv_end(void) {
+    uint16_t temp;
+
+    // Set Rx read pointer to next packet, it must stay inside Rx buffer
+    if (enc28j60_rxrdpt == ENC28J60_RXSTART)
+        temp = ENC28J60_RXEND;
+    else
+        temp = enc28j60_rxrdpt - 1;
+
+    const enc28j60_op_t ops[] = {
+        ENC28J60_WCR16(ERXRDPT, temp),
+        ENC28J60_BFS(ECON2, ECON2_PKTDEC), // Decrement packet counter
+    };
+    enc28j60_program(ops, sizeof(ops) / sizeof(ops[0]));
+}
+
+uint16_t enc28j60_recv_packet(uint8_t *buf, uint16_t buflen) {
+    uint16_t len = enc28j60_recv_begin();
+
+    if (len) {
+        if (len > buflen)
+            len = buflen;
+        enc28j60_recv_read(buf, len);
+        enc28j60_recv_end();
     }
 
     return len;
 }
+
+/*
+ * Rx filters
+ */
+
+// IP-style checksum over the bytes selected by the pattern match mask
+static uint16_t enc28j60_pattern_checksum(const uint8_t *data, uint8_t len) {
+    uint32_t sum = 0;
+
+    for (uint8_t i = 0; i < len; i += 2) {
+        sum += (data[i] << 8) | ((i + 1 < len) ? data[i + 1] : 0);
+    }
+    while (sum >> 16)
+        sum = (sum & 0xFFFF) + (sum >> 16);
+
+    return ~sum;
+}
+
+// Select which frames reach the Rx buffer, see ENC28J60_FILTER_*
+void enc28j60_set_filter(uint8_t filters) {
+    // Broadcast destination + ARP EtherType, i.e. bytes 0-5 and 12-13 of the frame
+    static const uint8_t arp_pattern[] = {0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0x08, 0x06};
+    uint16_t arp_checksum = enc28j60_pattern_checksum(arp_pattern, sizeof(arp_pattern));
+    uint8_t erxfcon = ERXFCON_CRCEN; // Drop frames with bad CRC
+
+    if (filters & ENC28J60_FILTER_UNICAST)
+        erxfcon |= ERXFCON_UCEN;
+    if (filters & ENC28J60_FILTER_BROADCAST)
+        erxfcon |= ERXFCON_BCEN;
+    if (filters & ENC28J60_FILTER_ARP)
+        erxfcon |= ERXFCON_PMEN;
+    if (filters & ENC28J60_FILTER_MULTICAST)
+        erxfcon |= ERXFCON_HTEN;
+
+    // All in bank 1
+    const enc28j60_op_t ops[] = {
+        ENC28J60_WCR16(EPMOL, 0),
+        ENC28J60_WCR(EPMM0, 0x3F),
+        ENC28J60_WCR(EPMM1, 0x30),
+        ENC28J60_WCR(EPMM2, 0x00),
+        ENC28J60_WCR(EPMM3, 0x00),
+        ENC28J60_WCR(EPMM4, 0x00),
+        ENC28J60_WCR(EPMM5, 0x00),
+        ENC28J60_WCR(EPMM6, 0x00),
+        ENC28J60_WCR(EPMM7, 0x00),
+        ENC28J60_WCR16(EPMCSL, arp_checksum),
+        ENC28J60_WCR(ERXFCON, erxfcon),
+    };
+    enc28j60_program(ops, sizeof(ops) / sizeof(ops[0]));
+}
+
+// Hash table bit of a destination MAC: bits 28:23 of its CRC-32
+static uint8_t enc28j60_hash_bit(const uint8_t *mac) {
+    uint32_t crc = 0xFFFFFFFF;
+
+    for (uint8_t i = 0; i < 6; i++) {
+        uint8_t data = mac[i];
+        for (uint8_t bit = 0; bit < 8; bit++) {
+            if (((crc >> 31) ^ data) & 0x01)
+                crc = (crc << 1) ^ 0x04C11DB7;
+            else
+                crc <<= 1;
+            data >>= 1;
+        }
+    }
+
+    return (crc >> 23) & 0x3F;
+}
+
+// Accept frames to a multicast MAC, groups sharing a hash bit are counted
+void enc28j60_hash_add(const uint8_t *mac) {
+    uint8_t bit = enc28j60_hash_bit(mac);
+
+    if (enc28j60_hash_refs[bit]++ == 0)
+        enc28j60_bfs(EHT0 + (bit >> 3), 1 << (bit & 0x07));
+}
+
+// Stop accepting frames to a multicast MAC once no group uses its hash bit
+void enc28j60_hash_remove(const uint8_t *mac) {
+    uint8_t bit = enc28j60_hash_bit(mac);
+
+    if (enc28j60_hash_refs[bit] && --enc28j60_hash_refs[bit] == 0)
+        enc28j60_bfc(EHT0 + (bit >> 3), 1 << (bit & 0x07));
+}
@@ -0,0 +1,81 @@
+#include "logger.h"
+#include "main.h"
+
+extern uint32_t sys_now(void);
+
+// USART1_TX DMA request shares DMA1 channel 4 with SPI2_RX (ENC28J60),
+// so the ring is drained one byte per TXE interrupt instead
+
+// Free-running indexes: only logger_write moves head, only logger_irq moves tail
+static volatile uint8_t logger_buf[LOGGER_BUFSIZE];
+static volatile uint32_t logger_head = 0;
+static volatile uint32_t logger_tail = 0;
+static volatile uint32_t logger_drops = 0; // writes that did not fit
+
+void logger_init(void) {
+    // Below the ENC28J60 interrupts, log output is never urgent
+    NVIC_SetPriority(USART1_IRQn, NVIC_EncodePriority(NVIC_GetPriorityGrouping(), 14, 0));
+    NVIC_EnableIRQ(USART1_IRQn);
+}
+
+int logger_write(const char *data, int len) {
+    uint32_t head = logger_head;
+
+    // Never wait for room: what does not fit is dropped whole, so the output
+    // never holds part of a record or a line
+    if (len > (int)(LOGGER_BUFSIZE - (head - logger_tail))) {
+        logger_drops++;
+        return len;
+    }
+
+    for (int i = 0; i < len; i++) {
+        logger_buf[head++ & (LOGGER_BUFSIZE - 1)] = data[i];
+    }
+    logger_head = head; // publish the whole write at once
+
+    if (len > 0)
+        LL_USART_EnableIT_TXE(USART1);
+
+    return len;
+}
+
+void logger_event(uint8_t id, uint8_t argc, uint32_t arg0, uint32_t arg1) {
+    uint8_t rec[4 + 4 * LOGGER_RECORD_ARGS];
+    uint32_t args[LOGGER_RECORD_ARGS] = {arg0, arg1};
+    uint32_t now = sys_now();
+    uint8_t len = 0;
+
+    if (argc > LOGGER_RECORD_ARGS)
+        argc = LOGGER_RECORD_ARGS;
+
+    rec[len++] = LOGGER_RECORD | argc;
+    rec[len++] = id;
+    rec[len++] = now;
+    rec[len++] = now >> 8;
+    for (uint8_t i = 0; i < argc; i++) {
+        rec[len++] = args[i];
+        rec[len++] = args[i] >> 8;
+        rec[len++] = args[i] >> 16;
+        rec[len++] = args[i] >> 24;
+    }
+
+    // One write, so a record is never split by other output
+    logger_write((const char *)rec, len);
+}
+
+uint32_t logger_dropped(void) {
+    return logger_drops;
+}
+
+void logger_irq(void) {
+    uint32_t head = logger_head;
+    uint32_t tail = logger_tail;
+
+    if (tail == head) {
+        LL_USART_DisableIT_TXE(USART1);
+    } else {
+        LL_USART_TransmitData8(USART1, logger_buf[tail & (LOGGER_BUFSIZE - 1)]);
+        tail++;
+    }
+    logger_tail = tail;
+}
@@ -1,11 +1,19 @@
 #include "mfrc522.h"
 #include "main.h"
 
-#define mfrc522_select()  RFID_NSS_GPIO_Port->BSRR = GPIO_BSRR_BR4
+extern uint32_t sys_now(void);
+
+#define mfrc522_select()                          \
+    do {                                          \
+        mfrc522_stats.spi++;                      \
+        RFID_NSS_GPIO_Port->BSRR = GPIO_BSRR_BR4; \
+    } while (0)
 #define mfrc522_release() RFID_NSS_GPIO_Port->BSRR = GPIO_BSRR_BS4
 #define mfrc522_reset()   RFID_RST_GPIO_Port->BSRR = GPIO_BSRR_BR11
 #define mfrc522_set()     RFID_RST_GPIO_Port->BSRR = GPIO_BSRR_BS11
 
+static mfrc522_stats_t mfrc522_stats = {0};
+
 static void mfrc522_spi_init() {
     LL_SPI_Enable(SPI1);
     mfrc522_release();
@@ -43,6 +51,36 @@ static void mfrc522_write_byte(uchar addr, uchar val) {
     mfrc522_release();
 }
 
+// Burst FIFO read: the address is repeated for every byte but the last,
+// the whole burst is one CS frame
+static void mfrc522_read_fifo(uchar *buf, uchar len) {
+    uchar addr = ((FIFODataReg << 1) & 0x7E) | 0x80;
+
+    if (len == 0)
+        return;
+
+    mfrc522_select();
+    mfrc522_spi_rw(addr);
+    for (int i = 0; i < len - 1; i++) {
+        buf[i] = mfrc522_spi_rw(addr);
+    }
+    buf[len - 1] = mfrc522_spi_rw(0x00);
+    mfrc522_release();
+}
+
+// Burst FIFO write: one address byte, then all data in one CS frame
+static void mfrc522_write_fifo(const uchar *buf, uchar len) {
+    if (len == 0)
+        return;
+
+    mfrc522_select();
+    mfrc522_spi_rw((FIFODataReg << 1) & 0x7E);
+    for (int i = 0; i < len; i++) {
+        mfrc522_spi_rw(buf[i]);
+    }
+    mfrc522_release();
+}
+
 /*
  * Internal functions
  */
@@ -65,32 +103,102 @@ static void mfrc522_antenna_off(void) {
     mfrc522_clear_bit_mask(TxControlReg, 0x03);
 }
 
-// Return 2-byte CRC
+// Tx1RFEn and Tx2RFEn drive the 13.56 MHz field
+void mfrc522_antenna(uchar on) {
+    if (on) {
+        mfrc522_antenna_on();
+    } else {
+        mfrc522_antenna_off();
+    }
+}
+
+// Soft power-down: oscillator and analog parts stop, registers and SPI keep working.
+// On wake-up the oscillator needs 1024 clocks, PowerDown reads 1 until it runs.
+void mfrc522_power_down(uchar on) {
+    mfrc522_write_byte(CommandReg, on ? (0x10 | PCD_IDLE) : PCD_IDLE);
+}
+
+static uint mfrc522_timeout = 0; // us, loaded in TReloadReg
+
+// Timeout of the next exchanges, the timer counts at 10 kHz.
+// The reload value is kept by the chip, only a change costs SPI writes.
+void mfrc522_set_timeout(uint us) {
+    uint reload = us / 100;
+
+    if (us == mfrc522_timeout)
+        return;
+    mfrc522_timeout = us;
+    mfrc522_write_byte(TReloadRegL, reload & 0xFF);
+    mfrc522_write_byte(TReloadRegH, reload >> 8);
+}
+
+// Receiver sensitivity: RxGain in RFCfgReg, MinLevel/CollLevel in RxThresholdReg
+void mfrc522_set_receiver(uchar rfcfg, uchar threshold) {
+    mfrc522_write_byte(RFCfgReg, rfcfg);
+    mfrc522_write_byte(RxThresholdReg, threshold);
+}
+
+// CRC_A of ISO14443-3: CRC-16/CCITT bit-reversed (polynomial 0x8408), preset 0x6363
+static const uint16_t mfrc522_crc_a_table[256] = {
+    0x0000, 0x1189, 0x2312, 0x329B, 0x4624, 0x57AD, 0x6536, 0x74BF,
+    0x8C48, 0x9DC1, 0xAF5A, 0xBED3, 0xCA6C, 0xDBE5, 0xE97E, 0xF8F7,
+    0x1081, 0x0108, 0x3393, 0x221A, 0x56A5, 0x472C, 0x75B7, 0x643E,
+    0x9CC9, 0x8D40, 0xBFDB, 0xAE52, 0xDAED, 0xCB64, 0xF9FF, 0xE876,
+    0x2102, 0x308B, 0x0210, 0x1399, 0x6726, 0x76AF, 0x4434, 0x55BD,
+    0xAD4A, 0xBCC3, 0x8E58, 0x9FD1, 0xEB6E, 0xFAE7, 0xC87C, 0xD9F5,
+    0x3183, 0x200A, 0x1291, 0x0318, 0x77A7, 0x662E, 0x54B5, 0x453C,
+    0xBDCB, 0xAC42, 0x9ED9, 0x8F50, 0xFBEF, 0xEA66, 0xD8FD, 0xC974,
+    0x4204, 0x538D, 0x6116, 0x709F, 0x0420, 0x15A9, 0x2732, 0x36BB,
+    0xCE4C, 0xDFC5, 0xED5E, 0xFCD7, 0x8868, 0x99E1, 0xAB7A, 0xBAF3,
+    0x5285, 0x430C, 0x7197, 0x601E, 0x14A1, 0x0528, 0x37B3, 0x263A,
+    0xDECD, 0xCF44, 0xFDDF, 0xEC56, 0x98E9, 0x8960, 0xBBFB, 0xAA72,
+    0x6306, 0x728F, 0x4014, 0x519D, 0x2522, 0x34AB, 0x0630, 0x17B9,
+    0xEF4E, 0xFEC7, 0xCC5C, 0xDDD5, 0xA96A, 0xB8E3, 0x8A78, 0x9BF1,
+    0x7387, 0x620E, 0x5095, 0x411C, 0x35A3, 0x242A, 0x16B1, 0x0738,
+    0xFFCF, 0xEE46, 0xDCDD, 0xCD54, 0xB9EB, 0xA862, 0x9AF9, 0x8B70,
+    0x8408, 0x9581, 0xA71A, 0xB693, 0xC22C, 0xD3A5, 0xE13E, 0xF0B7,
+    0x0840, 0x19C9, 0x2B52, 0x3ADB, 0x4E64, 0x5FED, 0x6D76, 0x7CFF,
+    0x9489, 0x8500, 0xB79B, 0xA612, 0xD2AD, 0xC324, 0xF1BF, 0xE036,
+    0x18C1, 0x0948, 0x3BD3, 0x2A5A, 0x5EE5, 0x4F6C, 0x7DF7, 0x6C7E,
+    0xA50A, 0xB483, 0x8618, 0x9791, 0xE32E, 0xF2A7, 0xC03C, 0xD1B5,
+    0x2942, 0x38CB, 0x0A50, 0x1BD9, 0x6F66, 0x7EEF, 0x4C74, 0x5DFD,
+    0xB58B, 0xA402, 0x9699, 0x8710, 0xF3AF, 0xE226, 0xD0BD, 0xC134,
+    0x39C3, 0x284A, 0x1AD1, 0x0B58, 0x7FE7, 0x6E6E, 0x5CF5, 0x4D7C,
+    0xC60C, 0xD785, 0xE51E, 0xF497, 0x8028, 0x91A1, 0xA33A, 0xB2B3,
+    0x4A44, 0x5BCD, 0x6956, 0x78DF, 0x0C60, 0x1DE9, 0x2F72, 0x3EFB,
+    0xD68D, 0xC704, 0xF59F, 0xE416, 0x90A9, 0x8120, 0xB3BB, 0xA232,
+    0x5AC5, 0x4B4C, 0x79D7, 0x685E, 0x1CE1, 0x0D68, 0x3FF3, 0x2E7A,
+    0xE70E, 0xF687, 0xC41C, 0xD595, 0xA12A, 0xB0A3, 0x8238, 0x93B1,
+    0x6B46, 0x7ACF, 0x4854, 0x59DD, 0x2D62, 0x3CEB, 0x0E70, 0x1FF9,
+    0xF78F, 0xE606, 0xD49D, 0xC514, 0xB1AB, 0xA022, 0x92B9, 0x8330,
+    0x7BC7, 0x6A4E, 0x58D5, 0x495C, 0x3DE3, 0x2C6A, 0x1EF1, 0x0F78,
+};
+
+// Return 2-byte CRC, low byte first as it goes on air.
+// Computed here rather than by PCD_CALCCRC, which costs 2n+6 SPI transactions.
 static void mfrc522_calc_crc(uchar *pIndata, uchar len, uchar *pOutData) {
-    mfrc522_clear_bit_mask(DivIrqReg, 0x04);  // CRCIrq = 0
-    mfrc522_set_bit_mask(FIFOLevelReg, 0x80); // Clear the FIFO pointer
+    uint16_t crc = 0x6363;
 
-    // Writing data to the FIFO
     for (int i = 0; i < len; i++) {
-        mfrc522_write_byte(FIFODataReg, *(pIndata + i));
+        crc = (crc >> 8) ^ mfrc522_crc_a_table[(crc ^ pIndata[i]) & 0xFF];
     }
-    mfrc522_write_byte(CommandReg, PCD_CALCCRC);
-
-    // Wait CRC calculation is complete
-    uchar wait = 0xFF;
-    uchar irq = 0x00;
-    do {
-        irq = mfrc522_read_byte(DivIrqReg);
-        wait--;
-    } while ((wait != 0) && !(irq & 0x04)); // CRCIrq = 1
 
-    // Read CRC calculation result
-    pOutData[0] = mfrc522_read_byte(CRCResultRegL);
-    pOutData[1] = mfrc522_read_byte(CRCResultRegH);
+    pOutData[0] = crc & 0xFF;
+    pOutData[1] = crc >> 8;
 }
 
-// ISO14443 communication
-static uchar mfrc522_talk_to_card(uchar command, uchar *sendData, uchar sendBytes, uchar *recvData, uint *recvBits) {
+// Command in progress, finished by mfrc522_transceive_poll()
+static uchar mfrc522_command = PCD_IDLE;
+static uchar mfrc522_irq_en = 0x00;
+static uchar mfrc522_wait_irq = 0x00;
+static uint32_t mfrc522_start_tick = 0;
+static uchar mfrc522_recv_size = MF_BLOCK_SIZE; // room in recvData, back to a block after each command
+static uchar mfrc522_ntag_fast_read_len = 0;    // bytes expected by the FAST_READ in progress
+
+// ISO14443 communication: load the FIFO, start the command and return at once.
+// The MFRC522 timer starts when the frame is sent (TAuto), so TimerIRq ends the
+// wait for a card that does not answer.
+uchar mfrc522_transceive_start(uchar command, uchar *sendData, uchar sendBytes) {
     uchar irqEn = 0x00;
     uchar waitIrq = 0x00;
 
@@ -112,15 +220,18 @@ static uchar mfrc522_talk_to_card(uchar command, uchar *sendData, uchar sendByte
     }
 
     // Prepare the command
-    mfrc522_write_byte(CommIEnReg, irqEn | 0x80); // Interrupt request
+    mfrc522_write_byte(CommIEnReg, irqEn | 0x80); // Interrupt request, IRQ pin active low
     mfrc522_clear_bit_mask(CommIrqReg, 0x80);     // Clear all interrupt request bit
     mfrc522_set_bit_mask(FIFOLevelReg, 0x80);     // FlushBuffer=1, FIFO Initialization
     mfrc522_write_byte(CommandReg, PCD_IDLE);     // NO action; Cancel the current command
 
     // Writing data to the FIFO
-    for (int i = 0; i < sendBytes; i++) {
-        mfrc522_write_byte(FIFODataReg, sendData[i]);
-    }
+    mfrc522_write_fifo(sendData, sendBytes);
+
+    mfrc522_command = command;
+    mfrc522_irq_en = irqEn;
+    mfrc522_wait_irq = waitIrq;
+    mfrc522_start_tick = sys_now();
 
     // Execute the command
     mfrc522_write_byte(CommandReg, command);
@@ -128,61 +239,134 @@ static uchar mfrc522_talk_to_card(uchar command, uchar *sendData, uchar sendByte
         mfrc522_set_bit_mask(BitFramingReg, 0x80); // StartSend=1, transmission of data starts
     }
 
-    // Waiting to receive data to complete
-    uint wait = 2000; // M1 card maximum waiting time is 25ms
+    return MI_OK;
+}
+
+// Check the command started by mfrc522_transceive_start(), MI_BUSY while it runs.
+// Costs one register read per call.
+uchar mfrc522_transceive_poll(uchar *recvData, uint *recvBits) {
     uchar irq;
-    do {
-        // CommIrqReg[7..0]
-        // Set1 TxIRq RxIRq IdleIRq HiAlerIRq LoAlertIRq ErrIRq TimerIRq
-        irq = mfrc522_read_byte(CommIrqReg);
-        wait--;
-    } while ((wait != 0) && !(irq & 0x01) && !(irq & waitIrq));
+
+    if (mfrc522_command == PCD_IDLE)
+        return MI_ERR;
+
+    // CommIrqReg[7..0]
+    // Set1 TxIRq RxIRq IdleIRq HiAlerIRq LoAlertIRq ErrIRq TimerIRq
+    irq = mfrc522_read_byte(CommIrqReg);
+    if (!(irq & 0x01) && !(irq & mfrc522_wait_irq))
+        return MI_BUSY;
 
     // Stop execution
     mfrc522_clear_bit_mask(BitFramingReg, 0x80); // StartSend=0
 
     uchar ret = MI_ERR;
-    // If not timeout
-    if (wait > 0) {
-        if (!(mfrc522_read_byte(ErrorReg) & 0x1B)) // BufferOvfl CollErr CRCErr ProtecolErr
-        {
-            ret = MI_OK;
-            if (irq & irqEn & 0x01) {
-                ret = MI_NOTAGERR;
+    uchar err = mfrc522_read_byte(ErrorReg);
+    if (!(err & 0x13)) // BufferOvfl CRCErr ProtecolErr
+    {
+        ret = MI_OK;
+        if (err & 0x08) { // CollErr, bits up to CollReg position are valid
+            ret = MI_COLL;
+        }
+        if (irq & mfrc522_irq_en & 0x01) { // timer ran out, nobody answered
+            ret = MI_NOTAGERR;
+        }
+
+        if (mfrc522_command == PCD_TRANSCEIVE) {
+            uchar len = mfrc522_read_byte(FIFOLevelReg);
+            uchar lastBits = mfrc522_read_byte(ControlReg) & 0x07;
+            if (lastBits) {
+                *recvBits = (len - 1) * 8 + lastBits;
+            } else {
+                *recvBits = len * 8;
             }
 
-            if (command == PCD_TRANSCEIVE) {
-                uchar len = mfrc522_read_byte(FIFOLevelReg);
-                uchar lastBits = mfrc522_read_byte(ControlReg) & 0x07;
-                if (lastBits) {
-                    *recvBits = (len - 1) * 8 + lastBits;
-                } else {
-                    *recvBits = len * 8;
-                }
-
-                if (len == 0) {
-                    len = 1;
-                }
-                if (len > MF_BLOCK_SIZE) {
-                    len = MF_BLOCK_SIZE;
-                }
-
-                // Reading the received data in FIFO
-                for (int i = 0; i < len; i++) {
-                    recvData[i] = mfrc522_read_byte(FIFODataReg);
-                }
+            if (len == 0) {
+                len = 1;
             }
-        } else {
-            ret = MI_ERR;
+            if (len > mfrc522_recv_size) {
+                len = mfrc522_recv_size;
+            }
+
+            // Reading the received data in FIFO
+            mfrc522_read_fifo(recvData, len);
         }
     }
 
     // mfrc522_set_bit_mask(ControlReg,0x80);           //timer stops
     mfrc522_write_byte(CommandReg, PCD_IDLE);
+    mfrc522_command = PCD_IDLE;
+    mfrc522_recv_size = MF_BLOCK_SIZE;
 
     return ret;
 }
 
+// Abort the command in progress
+void mfrc522_transceive_cancel(void) {
+    mfrc522_clear_bit_mask(BitFramingReg, 0x80); // StartSend=0
+    mfrc522_write_byte(CommandReg, PCD_IDLE);
+    mfrc522_command = PCD_IDLE;
+    mfrc522_recv_size = MF_BLOCK_SIZE;
+}
+
+const mfrc522_stats_t *mfrc522_get_stats(void) {
+    return &mfrc522_stats;
+}
+
+// The chip timer should have ended the command in progress by now,
+// in case it never fires (card answering forever, chip reset)
+static uchar mfrc522_overdue(void) {
+    return sys_now() - mfrc522_start_tick > mfrc522_timeout / 1000 + MFRC522_GUARD;
+}
+
+// Blocking ISO14443 communication
+static uchar mfrc522_talk_to_card(uchar command, uchar *sendData, uchar sendBytes, uchar *recvData, uint *recvBits) {
+    uchar status;
+
+    mfrc522_transceive_start(command, sendData, sendBytes);
+    do {
+        status = mfrc522_transceive_poll(recvData, recvBits);
+    } while ((status == MI_BUSY) && !mfrc522_overdue());
+
+    if (status == MI_BUSY) {
+        mfrc522_transceive_cancel();
+        status = MI_ERR;
+    }
+
+    return status;
+}
+
+// Blocking wrapper for the asynchronous operations below
+static uchar mfrc522_wait(uchar (*poll)(uchar *), uchar *buf) {
+    uchar status;
+
+    do {
+        status = poll(buf);
+    } while ((status == MI_BUSY) && !mfrc522_overdue());
+
+    if (status == MI_BUSY) {
+        mfrc522_transceive_cancel();
+        status = MI_ERR;
+    }
+
+    return status;
+}
+
+// Each anticollision round restarts the command, and so the guard
+static uchar mfrc522_wait_uid(uchar (*poll)(mfrc522_uid_t *), mfrc522_uid_t *uid) {
+    uchar status;
+
+    do {
+        status = poll(uid);
+    } while ((status == MI_BUSY) && !mfrc522_overdue());
+
+    if (status == MI_BUSY) {
+        mfrc522_transceive_cancel();
+        status = MI_ERR;
+    }
+
+    return status;
+}
+
 // Reset the MFRC522 using the soft reset function
 static void mfrc522_soft_reset(void) {
     mfrc522_write_byte(CommandReg, PCD_RESETPHASE);
@@ -211,14 +395,13 @@ void mfrc522_init(void) {
     /* configure registers */
     mfrc522_write_byte(ModeReg, 0x3D);       // CRC Initial value 0x6363
     mfrc522_write_byte(DemodReg, 0x5D);      // AddIQ = b01; FixIQ = b0; TPrescalEven = b1
-    mfrc522_write_byte(RFCfgReg, 0x70);      // set Rx Gain at 48dB
+    mfrc522_write_byte(RFCfgReg, MFRC522_RFCFG); // set Rx Gain at 48dB
     mfrc522_write_byte(TxASKReg, 0x40);      // force 100% ASK modulation
-    mfrc522_write_byte(TModeReg, 0x8D);      // TAuto = b1; TGate = b00; TAutoRestart=b0; TPreScalerHi= 0xD
-    mfrc522_write_byte(TPrescalerReg, 0x3D); // TPreScaler =  TPreScalerHi:TPreScalerLo = 0xD3D = 3389
+    mfrc522_write_byte(TModeReg, 0x82);      // TAuto = b1; TGate = b00; TAutoRestart=b0; TPreScalerHi= 0x2
+    mfrc522_write_byte(TPrescalerReg, 0xA5); // TPreScaler =  TPreScalerHi:TPreScalerLo = 0x2A5 = 677
                                              // TPrescalEven = 1 in DemodReg
-                                             // ftimer = 13.56 MHz / (2*TPreScaler+2) = 13.56 MHz / (2*3389 + 2) = 2000 Hz
-    mfrc522_write_byte(TReloadRegL, 0x30);   // 48 / 2000 = 24 ms
-    mfrc522_write_byte(TReloadRegH, 0x00);
+                                             // ftimer = 13.56 MHz / (2*TPreScaler+2) = 13.56 MHz / (2*677 + 2) = 10 kHz
+    mfrc522_set_timeout(MFRC522_TIMEOUT_SHORT); // 10 / 10 kHz = 1 ms, each command sets its own
     mfrc522_delay(100);
 
     mfrc522_antenna_on();
@@ -233,13 +416,30 @@ void mfrc522_init(void) {
 //    0x0800 = Mifare_Pro(X)
 //    0x4403 = Mifare_DESFire
 uchar mfrc522_request(uchar reqMode, uchar *TagType) {
-    uchar status;
-    uint recvBits;
+    mfrc522_request_start(reqMode);
+    return mfrc522_wait(mfrc522_request_poll, TagType);
+}
 
+// Send REQA/WUPA and return, mfrc522_request_poll() collects the ATQA
+uchar mfrc522_request_start(uchar reqMode) {
     mfrc522_write_byte(BitFramingReg, 0x07); // TxLastBists = BitFramingReg[2..0]
+    mfrc522_set_timeout(MFRC522_TIMEOUT_SHORT);
+
+    return mfrc522_transceive_start(PCD_TRANSCEIVE, &reqMode, 1);
+}
+
+// MI_BUSY until a card answered or the timer ran out
+uchar mfrc522_request_poll(uchar *TagType) {
+    uchar status;
+    uint recvBits = 0;
 
-    TagType[0] = reqMode;
-    status = mfrc522_talk_to_card(PCD_TRANSCEIVE, TagType, 1, TagType, &recvBits);
+    status = mfrc522_transceive_poll(TagType, &recvBits);
+    if (status == MI_BUSY) {
+        return status;
+    }
+    if (status == MI_COLL) {
+        status = MI_OK; // several cards answered, anticollision sorts them out
+    }
 
     if ((status != MI_OK) || (recvBits != 0x10 /* 2 Bytes */)) {
         status = MI_ERR;
@@ -248,55 +448,172 @@ uchar mfrc522_request(uchar reqMode, uchar *TagType) {
     return status;
 }
 
-// Anti-collision detection, reading selected card serial number card
+// Anti-collision detection at cascade level 1, reading selected card serial number card
 uchar mfrc522_anti_collision(uchar *serNum) {
+    mfrc522_uid_t uid;
     uchar status;
-    uint recvBits;
-
-    mfrc522_write_byte(BitFramingReg, 0x00); // TxLastBists = BitFramingReg[2..0]
-
-    serNum[0] = PICC_ANTICOLL;
-    serNum[1] = 0x20; // 32-bit serial number
-    status = mfrc522_talk_to_card(PCD_TRANSCEIVE, serNum, 2, serNum, &recvBits);
 
+    mfrc522_uid_init(&uid);
+    mfrc522_anticoll_start(&uid);
+    status = mfrc522_wait_uid(mfrc522_anticoll_poll, &uid);
     if (status == MI_OK) {
-        uchar serNumCheck = 0;
-        // Check card serial number
-        for (int i = 0; i < 4; i++) {
-            serNumCheck ^= serNum[i];
-        }
-        if (serNumCheck != serNum[4]) {
-            status = MI_ERR;
+        for (int i = 0; i < 5; i++) {
+            serNum[i] = uid.frame[i + 2];
         }
     }
 
     return status;
 }
 
-// Select the card, read the card storage capacity
+// Select the card at cascade level 1, read the card storage capacity
 uchar mfrc522_select_tag(uchar *serNum) {
-    uchar buffer[9];
+    mfrc522_uid_t uid;
+
+    mfrc522_uid_init(&uid);
+    for (int i = 0; i < 5; i++) {
+        uid.frame[i + 2] = serNum[i];
+    }
+    mfrc522_select_level_start(&uid);
+    if (mfrc522_wait_uid(mfrc522_select_level_poll, &uid) != MI_OK) {
+        return 0;
+    }
+
+    return uid.sak;
+}
+
+/*
+ * ISO14443A cascade: anticollision then select at each level until SAK has no cascade bit
+ */
+
+static const uchar mfrc522_sel_cmd[3] = {PICC_ANTICOLL, PICC_ANTICOLL_CL2, PICC_ANTICOLL_CL3};
+
+void mfrc522_uid_init(mfrc522_uid_t *uid) {
+    uid->level = 0;
+    uid->known_bits = 0;
+    uid->uid_len = 0;
+    uid->sak = 0;
+}
+
+// Send ANTICOLLISION with the UID bits known so far at this level
+uchar mfrc522_anticoll_start(mfrc522_uid_t *uid) {
+    uchar bytes = uid->known_bits / 8;
+    uchar bits = uid->known_bits % 8;
+
+    uid->frame[0] = mfrc522_sel_cmd[uid->level];
+    uid->frame[1] = ((2 + bytes) << 4) | bits; // NVB
+
+    mfrc522_clear_bit_mask(CollReg, 0x80);                // ValuesAfterColl=0, bits after a collision read 0
+    mfrc522_write_byte(BitFramingReg, (bits << 4) | bits); // RxAlign = TxLastBits = bits of the last byte
+    mfrc522_set_timeout(MFRC522_TIMEOUT_SHORT);
+
+    return mfrc522_transceive_start(PCD_TRANSCEIVE, uid->frame, 2 + bytes + (bits ? 1 : 0));
+}
+
+// MI_BUSY while it runs: a collision fixes one more bit (the card with a 1 there wins)
+// and sends the next ANTICOLLISION by itself. MI_OK when the 4 UID bytes and BCC are in.
+uchar mfrc522_anticoll_poll(mfrc522_uid_t *uid) {
+    uchar rx[MF_BLOCK_SIZE];
+    uint recvBits = 0;
+    uchar bytes = uid->known_bits / 8;
+    uchar bits = uid->known_bits % 8;
     uchar status;
-    uint recvBits;
 
-    // mfrc522_clear_bit_mask(Status2Reg, 0x08);			//MFCrypto1On=0
+    status = mfrc522_transceive_poll(rx, &recvBits);
+    if (status == MI_BUSY) {
+        return status;
+    }
+    if (status != MI_OK && status != MI_COLL) {
+        return MI_ERR;
+    }
 
-    buffer[0] = PICC_SElECTTAG;
-    buffer[1] = 0x70;
-    for (int i = 0; i < 5; i++) {
-        buffer[i + 2] = *(serNum + i);
+    // The answer starts inside the last sent byte when bits != 0
+    uchar len = (recvBits + 7) / 8;
+    for (uchar i = 0; i < len && 2 + bytes + i < 7; i++) {
+        if (i == 0 && bits) {
+            uchar mask = 0xFF << bits;
+            uid->frame[2 + bytes] = (uid->frame[2 + bytes] & ~mask) | (rx[0] & mask);
+        } else {
+            uid->frame[2 + bytes + i] = rx[i];
+        }
+    }
+
+    if (status == MI_COLL) {
+        uchar coll = mfrc522_read_byte(CollReg);
+        if (coll & 0x20) { // CollPosNotValid
+            return MI_ERR;
+        }
+        uchar pos = coll & 0x1F; // counted from the first bit of the first FIFO byte
+        if (pos == 0) {
+            pos = 32;
+        }
+        pos += bytes * 8;
+        if (pos <= uid->known_bits || pos > 32) {
+            return MI_ERR;
+        }
+
+        uid->known_bits = pos;
+        uid->frame[2 + (pos - 1) / 8] |= 1 << ((pos - 1) % 8);
+        mfrc522_anticoll_start(uid);
+        return MI_BUSY;
+    }
+
+    // Check card serial number
+    uchar serNumCheck = 0;
+    for (int i = 2; i < 6; i++) {
+        serNumCheck ^= uid->frame[i];
+    }
+    if (serNumCheck != uid->frame[6]) {
+        return MI_ERR;
+    }
+
+    uid->known_bits = 32;
+    return MI_OK;
+}
+
+// Send SELECT for the UID part resolved at this level
+uchar mfrc522_select_level_start(mfrc522_uid_t *uid) {
+    uid->frame[0] = mfrc522_sel_cmd[uid->level];
+    uid->frame[1] = 0x70; // NVB: all 40 bits
+    mfrc522_write_byte(BitFramingReg, 0x00);
+    mfrc522_calc_crc(uid->frame, 7, &uid->frame[7]);
+    mfrc522_set_timeout(MFRC522_TIMEOUT_SHORT);
+
+    return mfrc522_transceive_start(PCD_TRANSCEIVE, uid->frame, 9);
+}
+
+// MI_OK with SAK in uid->sak. If SAK has the cascade bit, the UID goes on at the next level:
+// level is moved on and anticollision must run again.
+uchar mfrc522_select_level_poll(mfrc522_uid_t *uid) {
+    uchar rx[MF_BLOCK_SIZE];
+    uint recvBits = 0;
+    uchar status;
+
+    status = mfrc522_transceive_poll(rx, &recvBits);
+    if (status == MI_BUSY) {
+        return status;
+    }
+    if ((status != MI_OK) || (recvBits != 0x18 /* SAK + CRC_A */)) {
+        return MI_ERR;
     }
-    mfrc522_calc_crc(buffer, 7, &buffer[7]);
-    status = mfrc522_talk_to_card(PCD_TRANSCEIVE, buffer, 9, buffer, &recvBits);
 
-    uchar size;
-    if ((status == MI_OK) && (recvBits == 0x18 /* 3 Bytes */)) {
-        size = buffer[0];
+    uid->sak = rx[0];
+    if (uid->sak & PICC_SAK_CASCADE) {
+        // UID not complete, the first byte of this level is the cascade tag
+        if (uid->frame[2] != PICC_CT || uid->level == 2) {
+            return MI_ERR;
+        }
+        for (int i = 3; i < 6; i++) {
+            uid->uid[uid->uid_len++] = uid->frame[i];
+        }
+        uid->level++;
+        uid->known_bits = 0;
     } else {
-        size = 0;
+        for (int i = 2; i < 6; i++) {
+            uid->uid[uid->uid_len++] = uid->frame[i];
+        }
     }
 
-    return size;
+    return MI_OK;
 }
 
 // Verify card password
@@ -305,9 +622,24 @@ uchar mfrc522_select_tag(uchar *serNum) {
 //  Sectorkey - Sector password
 //  serNum - Card serial number, 4-byte
 uchar mfrc522_auth(uchar authMode, uchar BlockAddr, uchar *Sectorkey, uchar *serNum) {
-    uchar buff[12];
     uchar status;
-    uint recvBits;
+
+    mfrc522_auth_start(authMode, BlockAddr, Sectorkey, serNum);
+    do {
+        status = mfrc522_auth_poll();
+    } while ((status == MI_BUSY) && !mfrc522_overdue());
+
+    if (status == MI_BUSY) {
+        mfrc522_transceive_cancel();
+        status = MI_ERR;
+    }
+
+    return status;
+}
+
+// Start MFAuthent, the following exchanges with the card are encrypted by the MFRC522
+uchar mfrc522_auth_start(uchar authMode, uchar BlockAddr, const uchar *Sectorkey, const uchar *serNum) {
+    uchar buff[12];
 
     // Verify the command block address + sector + password + card serial number
     buff[0] = authMode;
@@ -318,7 +650,21 @@ uchar mfrc522_auth(uchar authMode, uchar BlockAddr, uchar *Sectorkey, uchar *ser
     for (int i = 0; i < 4; i++) {
         buff[i + 8] = *(serNum + i);
     }
-    status = mfrc522_talk_to_card(PCD_AUTHENT, buff, 12, buff, &recvBits);
+    mfrc522_set_timeout(MFRC522_TIMEOUT_AUTH);
+
+    return mfrc522_transceive_start(PCD_AUTHENT, buff, 12);
+}
+
+// MI_OK once MFCrypto1On is set, a wrong key leaves the card idle and unselected
+uchar mfrc522_auth_poll(void) {
+    uchar buf[MF_BLOCK_SIZE]; // MFAuthent leaves nothing in the FIFO
+    uchar status;
+    uint recvBits;
+
+    status = mfrc522_transceive_poll(buf, &recvBits);
+    if (status == MI_BUSY) {
+        return status;
+    }
 
     if ((status != MI_OK) || (!(mfrc522_read_byte(Status2Reg) & 0x08))) {
         status = MI_ERR;
@@ -327,15 +673,35 @@ uchar mfrc522_auth(uchar authMode, uchar BlockAddr, uchar *Sectorkey, uchar *ser
     return status;
 }
 
+// Leave the authenticated state, REQA/WUPA must go out in plain again
+void mfrc522_stop_crypto1(void) {
+    mfrc522_clear_bit_mask(Status2Reg, 0x08); // MFCrypto1On = 0
+}
+
 // Read a block of data, maximum 16 bytes + 2-byte CRC
 uchar mfrc522_read_block(uchar blockAddr, uchar *recvData) {
+    mfrc522_read_block_start(blockAddr);
+    return mfrc522_wait(mfrc522_read_block_poll, recvData);
+}
+
+uchar mfrc522_read_block_start(uchar blockAddr) {
+    uchar buffer[4];
+
+    buffer[0] = PICC_READ;
+    buffer[1] = blockAddr;
+    mfrc522_calc_crc(buffer, 2, &buffer[2]);
+    mfrc522_set_timeout(MFRC522_TIMEOUT_READ);
+    return mfrc522_transceive_start(PCD_TRANSCEIVE, buffer, 4);
+}
+
+uchar mfrc522_read_block_poll(uchar *recvData) {
     uchar status;
-    uint recvBits;
+    uint recvBits = 0;
 
-    recvData[0] = PICC_READ;
-    recvData[1] = blockAddr;
-    mfrc522_calc_crc(recvData, 2, &recvData[2]);
-    status = mfrc522_talk_to_card(PCD_TRANSCEIVE, recvData, 4, recvData, &recvBits);
+    status = mfrc522_transceive_poll(recvData, &recvBits);
+    if (status == MI_BUSY) {
+        return status;
+    }
 
     if ((status != MI_OK) || (recvBits != 0x90 /* 18 Bytes */)) {
         status = MI_ERR;
@@ -353,6 +719,7 @@ uchar mfrc522_write_block(uchar blockAddr, uchar *writeData) {
     buff[0] = PICC_WRITE;
     buff[1] = blockAddr;
     mfrc522_calc_crc(buff, 2, &buff[2]);
+    mfrc522_set_timeout(MFRC522_TIMEOUT_WRITE);
     status = mfrc522_talk_to_card(PCD_TRANSCEIVE, buff, 4, buff, &recvBits);
 
     if ((status != MI_OK) || (recvBits != 4) || ((buff[0] & 0x0F) != 0x0A)) {
@@ -377,11 +744,176 @@ uchar mfrc522_write_block(uchar blockAddr, uchar *writeData) {
 
 // Tell card go into hibernation
 void mfrc522_halt(void) {
+    uchar buff[MF_BLOCK_SIZE];
+
+    mfrc522_halt_start();
+    mfrc522_wait(mfrc522_halt_poll, buff);
+}
+
+// The card does not answer HLTA, the command ends on TimerIRq or can be cancelled
+uchar mfrc522_halt_start(void) {
     uchar buff[4];
-    uint recvBits;
 
     buff[0] = PICC_HALT;
     buff[1] = 0;
     mfrc522_calc_crc(buff, 2, &buff[2]);
-    mfrc522_talk_to_card(PCD_TRANSCEIVE, buff, 4, buff, &recvBits);
+    mfrc522_set_timeout(MFRC522_TIMEOUT_SHORT);
+    return mfrc522_transceive_start(PCD_TRANSCEIVE, buff, 4);
+}
+
+uchar mfrc522_halt_poll(uchar *buf) {
+    uint recvBits;
+
+    return mfrc522_transceive_poll(buf, &recvBits);
+}
+
+/*
+ * NTAG21x / Ultralight (Type 2 tags)
+ */
+
+// ATQA 0x0044 and SAK 0x00: a Type 2 tag, worth a GET_VERSION
+uchar mfrc522_ntag_detect(const uchar *atqa, uchar sak) {
+    return atqa[0] == 0x44 && atqa[1] == 0x00 && sak == 0x00;
+}
+
+// 8 bytes: header, vendor (0x04 NXP), type (0x03 Ultralight, 0x04 NTAG), subtype,
+// major, minor, storage size, protocol. Ultralight and Ultralight C do not know the
+// command, they do not answer and go back to idle: select them again before READ.
+uchar mfrc522_ntag_get_version(uchar *version) {
+    uchar buff[MF_BLOCK_SIZE];
+    uchar status;
+
+    mfrc522_ntag_version_start();
+    status = mfrc522_wait(mfrc522_ntag_version_poll, buff);
+    if (status != MI_OK) {
+        return status;
+    }
+    for (int i = 0; i < 8; i++) {
+        version[i] = buff[i];
+    }
+
+    return MI_OK;
+}
+
+uchar mfrc522_ntag_version_start(void) {
+    uchar buff[3];
+
+    buff[0] = PICC_GET_VERSION;
+    mfrc522_calc_crc(buff, 1, &buff[1]);
+    mfrc522_write_byte(BitFramingReg, 0x00);
+    mfrc522_set_timeout(MFRC522_TIMEOUT_SHORT);
+    return mfrc522_transceive_start(PCD_TRANSCEIVE, buff, 3);
+}
+
+// The version lands in the first 8 bytes of recvData, MF_BLOCK_SIZE bytes long
+uchar mfrc522_ntag_version_poll(uchar *recvData) {
+    uchar status;
+    uint recvBits = 0;
+
+    status = mfrc522_transceive_poll(recvData, &recvBits);
+    if (status == MI_BUSY) {
+        return status;
+    }
+
+    if ((status != MI_OK) || (recvBits != 0x50 /* 8 Bytes + CRC_A */)) {
+        status = MI_ERR;
+    }
+
+    return status;
+}
+
+// User memory in pages, from the GET_VERSION storage size byte
+uint mfrc522_ntag_user_pages(const uchar *version) {
+    switch (version[6]) {
+    case 0x0B: // Ultralight EV1 MF0UL11, 48 bytes
+        return 12;
+    case 0x0E: // Ultralight EV1 MF0UL21, 128 bytes
+        return 32;
+    case 0x0F: // NTAG213, 144 bytes
+        return 36;
+    case 0x11: // NTAG215, 504 bytes
+        return 126;
+    case 0x13: // NTAG216, 888 bytes
+        return 222;
+    default: // what every Type 2 tag has
+        return 12;
+    }
+}
+
+// Read pages start..end into recvData with as few FAST_READ frames as the FIFO allows
+uchar mfrc522_ntag_fast_read(uint start, uint end, uchar *recvData) {
+    uchar status;
+
+    while (start <= end) {
+        uint last = (end - start >= NTAG_FAST_READ_MAX) ? start + NTAG_FAST_READ_MAX - 1 : end;
+
+        mfrc522_ntag_fast_read_start(start, last);
+        status = mfrc522_wait(mfrc522_ntag_fast_read_poll, recvData);
+        if (status != MI_OK) {
+            return status;
+        }
+        recvData += (last - start + 1) * NTAG_PAGE_SIZE;
+        start = last + 1;
+    }
+
+    return MI_OK;
+}
+
+// One FAST_READ frame, at most NTAG_FAST_READ_MAX pages
+uchar mfrc522_ntag_fast_read_start(uchar start, uchar end) {
+    uchar buff[5];
+
+    buff[0] = PICC_FAST_READ;
+    buff[1] = start;
+    buff[2] = end;
+    mfrc522_calc_crc(buff, 3, &buff[3]);
+    mfrc522_write_byte(BitFramingReg, 0x00);
+    mfrc522_set_timeout(MFRC522_TIMEOUT_FAST_READ);
+    mfrc522_ntag_fast_read_len = (end - start + 1) * NTAG_PAGE_SIZE;
+    mfrc522_recv_size = mfrc522_ntag_fast_read_len; // the pages only, the CRC_A stays in the FIFO
+    return mfrc522_transceive_start(PCD_TRANSCEIVE, buff, 5);
+}
+
+// The pages go straight to recvData, (end - start + 1) * NTAG_PAGE_SIZE bytes
+uchar mfrc522_ntag_fast_read_poll(uchar *recvData) {
+    uchar status;
+    uint recvBits = 0;
+
+    status = mfrc522_transceive_poll(recvData, &recvBits);
+    if (status == MI_BUSY) {
+        return status;
+    }
+
+    if ((status != MI_OK) || (recvBits != (uint)(mfrc522_ntag_fast_read_len + 2) * 8 /* pages + CRC_A */)) {
+        status = MI_ERR;
+    }
+
+    return status;
+}
+
+// Pull the whole user memory (NDEF area) of a selected NTAG/Ultralight EV1:
+// GET_VERSION for its size, then FAST_READ from page 4. An NTAG213 takes 1 + 3
+// frames and an NTAG216 1 + 15, where READ needs 9 and 56.
+uchar mfrc522_ntag_read_ndef(uchar *recvData, uint size, uint *len) {
+    uchar version[8];
+    uint pages;
+
+    *len = 0;
+    if (mfrc522_ntag_get_version(version) != MI_OK) {
+        return MI_ERR;
+    }
+
+    pages = mfrc522_ntag_user_pages(version);
+    if (pages > size / NTAG_PAGE_SIZE) {
+        pages = size / NTAG_PAGE_SIZE;
+    }
+    if (pages == 0) {
+        return MI_OK;
+    }
+    if (mfrc522_ntag_fast_read(NTAG_USER_PAGE, NTAG_USER_PAGE + pages - 1, recvData) != MI_OK) {
+        return MI_ERR;
+    }
+
+    *len = pages * NTAG_PAGE_SIZE;
+    return MI_OK;
 }
@@ -0,0 +1,422 @@
+#include "reader.h"
+#include "logger.h"
+
+#include <string.h>
+
+extern uint32_t sys_now(void);
+
+static reader_state_t reader_cur = READER_IDLE;
+static uint32_t reader_tick = 0; // when the current state started
+static reader_sweep_t reader_batch;  // cards of the sweep in progress
+static reader_sweep_t reader_result; // last finished sweep
+static reader_stats_t reader_stats = {0};
+static reader_card_t *reader_found = &reader_batch.cards[0];
+static mfrc522_uid_t reader_uid;
+static uint8_t reader_wake = 0; // next request is the first of a sweep
+static uint8_t reader_miss = 0; // cards lost during this sweep
+static uint8_t reader_buf[MF_BLOCK_SIZE + 2];
+static uint8_t reader_field = 1;       // antenna on, mfrc522_init() leaves it so
+static uint32_t reader_field_tick = 0; // since when field_ms is not counted
+static uint8_t reader_swept = 0;       // a sweep ended during this poll
+static uint32_t reader_card_tick = 0;  // when the current card slot started
+#if READER_READ_SECTOR >= 0
+static const uint8_t reader_keys[][6] = READER_KEYS;
+static uint8_t reader_key = 0;      // keys tried on the current card
+static uint8_t reader_key_hint = 0; // key that worked last
+static uint8_t reader_block = 0;    // next block of the sector to read
+
+#define READER_KEY_COUNT (sizeof(reader_keys) / sizeof(reader_keys[0]))
+// 4K cards have 16-block sectors from sector 32 on
+#define READER_FIRST_BLOCK \
+    (READER_READ_SECTOR < 32 ? READER_READ_SECTOR * 4 : 128 + (READER_READ_SECTOR - 32) * 16)
+#endif
+#if READER_NTAG_PAGES > 0
+static uint8_t reader_plain = 0; // no NTAG commands for the current card, it does not know them
+static uint8_t reader_pages = 0; // NTAG pages to read
+static uint8_t reader_page = 0;  // NTAG pages read
+static uint8_t reader_frame = 0; // pages of the FAST_READ in flight
+#endif
+#if READER_CARD_DATA
+static uint8_t reader_again = 0; // the current card is selected again after a failed payload read
+#endif
+#if READER_LPCD
+static uint8_t reader_sensing = 0; // the request in flight is a sense pulse
+#endif
+
+static const uint16_t reader_timeout[] = {
+    [READER_IDLE] = READER_POLL_INTERVAL,
+    [READER_REQA] = READER_REQA_TIMEOUT,
+    [READER_ANTICOLL] = READER_ANTICOLL_TIMEOUT,
+    [READER_SELECT] = READER_SELECT_TIMEOUT,
+    [READER_AUTH] = READER_AUTH_TIMEOUT,
+    [READER_READ] = READER_READ_TIMEOUT,
+    [READER_VERSION] = READER_VERSION_TIMEOUT,
+    [READER_PAGES] = READER_PAGES_TIMEOUT,
+    [READER_HALT] = READER_HALT_TIMEOUT,
+    [READER_SLEEP] = READER_LPCD_INTERVAL,
+    [READER_SENSE] = READER_LPCD_SETTLE,
+};
+
+// Add the antenna time up to now to the stats
+static void reader_field_count(void) {
+    uint32_t now = sys_now();
+    if (reader_field) {
+        reader_stats.field_ms += now - reader_field_tick;
+    }
+    reader_field_tick = now;
+}
+
+static void reader_enter(reader_state_t state) {
+    reader_cur = state;
+    reader_tick = sys_now();
+
+    switch (state) {
+    case READER_REQA:
+        // WUPA also brings back the cards halted by the previous sweep
+        mfrc522_request_start(reader_wake ? PICC_REQALL : PICC_REQIDL);
+        break;
+    case READER_ANTICOLL:
+        mfrc522_anticoll_start(&reader_uid);
+        break;
+    case READER_SELECT:
+        mfrc522_select_level_start(&reader_uid);
+        break;
+#if READER_READ_SECTOR >= 0
+    case READER_AUTH:
+        // 7 and 10-byte UIDs authenticate with their last 4 bytes
+        mfrc522_auth_start(READER_KEY_TYPE, READER_FIRST_BLOCK,
+                           reader_keys[(reader_key_hint + reader_key) % READER_KEY_COUNT],
+                           &reader_found->uid[reader_found->uid_len - 4]);
+        break;
+    case READER_READ:
+        mfrc522_read_block_start(READER_FIRST_BLOCK + reader_block);
+        break;
+#endif
+#if READER_NTAG_PAGES > 0
+    case READER_VERSION:
+        mfrc522_ntag_version_start();
+        break;
+    case READER_PAGES:
+        reader_frame = reader_pages - reader_page;
+        if (reader_frame > NTAG_FAST_READ_MAX) {
+            reader_frame = NTAG_FAST_READ_MAX;
+        }
+        mfrc522_ntag_fast_read_start(NTAG_USER_PAGE + reader_page, NTAG_USER_PAGE + reader_page + reader_frame - 1);
+        break;
+#endif
+    case READER_HALT:
+        mfrc522_halt_start();
+        break;
+#if READER_LPCD
+    case READER_SLEEP:
+        reader_field_count();
+        reader_field = 0;
+        mfrc522_antenna(0);
+        mfrc522_power_down(1);
+        break;
+    case READER_SENSE:
+        reader_field_count();
+        reader_field = 1;
+        mfrc522_power_down(0);
+#if READER_LPCD_RFCFG != MFRC522_RFCFG || READER_LPCD_RXTHRESHOLD != MFRC522_RXTHRESHOLD
+        mfrc522_set_receiver(READER_LPCD_RFCFG, READER_LPCD_RXTHRESHOLD);
+#endif
+        mfrc522_antenna(1);
+        break;
+#endif
+    default:
+        break;
+    }
+}
+
+// Close the sweep, publish its cards
+static void reader_sweep_end(void) {
+    reader_result = reader_batch;
+    reader_stats.sweeps++;
+    reader_stats.tags += reader_batch.count;
+    reader_swept = 1;
+#if READER_LPCD
+    // The field is empty again, back to sense pulses
+    if (reader_batch.count == 0) {
+        reader_enter(READER_SLEEP);
+        return;
+    }
+#endif
+    reader_enter(READER_IDLE);
+}
+
+// Look for one more card
+static void reader_slot_start(void) {
+    reader_found = &reader_batch.cards[reader_batch.count];
+    reader_card_tick = sys_now();
+#if READER_READ_SECTOR >= 0
+    reader_key = 0;
+#endif
+#if READER_NTAG_PAGES > 0
+    reader_plain = 0;
+#endif
+#if READER_CARD_DATA
+    reader_again = 0;
+#endif
+    reader_enter(READER_REQA);
+}
+
+// Current card is done or lost, go for the next one
+static void reader_next(uint8_t found) {
+    if (found) {
+        uint32_t ms = sys_now() - reader_card_tick;
+        reader_stats.card_ms += ms;
+        if (ms > reader_stats.card_max) {
+            reader_stats.card_max = ms;
+        }
+        if (ms > READER_CARD_BUDGET) {
+            reader_stats.slow++;
+            LOG_EVENT2(LOG_EV_CARD_SLOW, "card %08lX took %lu ms",
+                       (uint32_t)reader_found->uid[0] << 24 | (uint32_t)reader_found->uid[1] << 16 |
+                           (uint32_t)reader_found->uid[2] << 8 | reader_found->uid[3],
+                       ms);
+        }
+        reader_batch.count++;
+    } else {
+        reader_miss++;
+    }
+
+    if (reader_batch.count == READER_INVENTORY_MAX || reader_miss > READER_INVENTORY_MISS) {
+        reader_sweep_end();
+        return;
+    }
+
+    reader_slot_start();
+}
+
+uint8_t reader_poll(void) {
+    uint8_t status;
+
+    // Nothing running on the MFRC522 in idle, just wait for the poll interval
+    if (reader_cur == READER_IDLE || reader_cur == READER_SLEEP || reader_cur == READER_SENSE) {
+        if (sys_now() - reader_tick < reader_timeout[reader_cur]) {
+            return READER_NONE;
+        }
+#if READER_LPCD
+        if (reader_cur == READER_SLEEP) {
+            reader_stats.senses++;
+            reader_enter(READER_SENSE);
+            return READER_NONE;
+        }
+        reader_sensing = (reader_cur == READER_SENSE);
+#endif
+        reader_batch.count = 0;
+        reader_miss = 0;
+        reader_wake = 1;
+        reader_slot_start();
+        return READER_NONE;
+    }
+
+    switch (reader_cur) {
+    case READER_REQA:
+        status = mfrc522_request_poll(reader_found->atqa);
+        break;
+    case READER_ANTICOLL:
+        status = mfrc522_anticoll_poll(&reader_uid);
+        break;
+    case READER_SELECT:
+        status = mfrc522_select_level_poll(&reader_uid);
+        break;
+#if READER_READ_SECTOR >= 0
+    case READER_AUTH:
+        status = mfrc522_auth_poll();
+        break;
+    case READER_READ:
+        status = mfrc522_read_block_poll(reader_buf);
+        break;
+#endif
+#if READER_NTAG_PAGES > 0
+    case READER_VERSION:
+        status = mfrc522_ntag_version_poll(reader_buf);
+        break;
+    case READER_PAGES:
+        status = mfrc522_ntag_fast_read_poll(&reader_found->data[reader_page * NTAG_PAGE_SIZE]);
+        break;
+#endif
+    default:
+        status = mfrc522_halt_poll(reader_buf);
+        break;
+    }
+
+    if (status == MI_BUSY) {
+        if (sys_now() - reader_tick < reader_timeout[reader_cur]) {
+            return READER_NONE;
+        }
+        mfrc522_transceive_cancel();
+        // HLTA has no answer, running out of time is how it ends
+        status = (reader_cur == READER_HALT) ? MI_OK : MI_ERR;
+    }
+
+    switch (reader_cur) {
+    case READER_REQA:
+        reader_wake = 0;
+#if READER_LPCD
+        if (reader_sensing) {
+            reader_sensing = 0;
+            if (status != MI_OK) {
+                // Field left undisturbed, no sweep to report
+                reader_enter(READER_SLEEP);
+                return READER_NONE;
+            }
+            // A card is there, full sweeps with the normal setup from now on
+#if READER_LPCD_RFCFG != MFRC522_RFCFG || READER_LPCD_RXTHRESHOLD != MFRC522_RXTHRESHOLD
+            mfrc522_set_receiver(MFRC522_RFCFG, MFRC522_RXTHRESHOLD);
+#endif
+        }
+#endif
+        if (status == MI_OK) {
+#if READER_CARD_DATA
+            reader_found->blocks = 0;
+#endif
+            mfrc522_uid_init(&reader_uid);
+            reader_enter(READER_ANTICOLL);
+        } else {
+            // Nobody left in the field
+            reader_sweep_end();
+        }
+        break;
+    case READER_ANTICOLL:
+        // Colliding cards are told apart bit by bit inside this state
+        if (status == MI_OK) {
+            reader_enter(READER_SELECT);
+        } else {
+            reader_next(0);
+        }
+        break;
+    case READER_SELECT:
+        if (status != MI_OK) {
+            reader_next(0);
+        } else if (reader_uid.sak & PICC_SAK_CASCADE) {
+            reader_enter(READER_ANTICOLL); // next cascade level
+        } else {
+#if READER_CARD_DATA
+            // Selected again after a failed read: another card in the field may have
+            // answered first, it starts over with every key and its own time
+            if (reader_again && (reader_uid.uid_len != reader_found->uid_len ||
+                                 memcmp(reader_uid.uid, reader_found->uid, reader_uid.uid_len) != 0)) {
+#if READER_READ_SECTOR >= 0
+                reader_key = 0;
+#endif
+#if READER_NTAG_PAGES > 0
+                reader_plain = 0;
+#endif
+                reader_card_tick = sys_now();
+            }
+            reader_again = 0;
+#endif
+            for (uint8_t i = 0; i < reader_uid.uid_len; i++) {
+                reader_found->uid[i] = reader_uid.uid[i];
+            }
+            reader_found->uid_len = reader_uid.uid_len;
+            reader_found->sak = reader_uid.sak;
+#if READER_READ_SECTOR >= 0
+            if ((reader_uid.sak & PICC_SAK_CLASSIC) && reader_key < READER_KEY_COUNT) {
+                reader_enter(READER_AUTH);
+                break;
+            }
+#endif
+#if READER_NTAG_PAGES > 0
+            if (!reader_plain && mfrc522_ntag_detect(reader_found->atqa, reader_uid.sak)) {
+                reader_enter(READER_VERSION);
+                break;
+            }
+#endif
+            reader_enter(READER_HALT);
+        }
+        break;
+#if READER_READ_SECTOR >= 0
+    case READER_AUTH:
+        if (status == MI_OK) {
+            reader_key_hint = (reader_key_hint + reader_key) % READER_KEY_COUNT;
+            reader_block = 0;
+            reader_enter(READER_READ);
+        } else {
+            // A wrong key drops the card back to idle: select it again for the next key,
+            // once the keys run out it is only halted
+            reader_key++;
+            reader_again = 1;
+            reader_enter(READER_REQA);
+        }
+        break;
+    case READER_READ:
+        if (status == MI_OK) {
+            for (uint8_t i = 0; i < MF_BLOCK_SIZE; i++) {
+                reader_found->data[reader_block * MF_BLOCK_SIZE + i] = reader_buf[i];
+            }
+            reader_found->blocks = ++reader_block;
+            if (reader_block < READER_READ_BLOCKS) {
+                reader_enter(READER_READ);
+                break;
+            }
+        }
+        reader_enter(READER_HALT);
+        break;
+#endif
+#if READER_NTAG_PAGES > 0
+    case READER_VERSION:
+        if (status == MI_OK) {
+            uint pages = mfrc522_ntag_user_pages(reader_buf);
+            reader_pages = pages < READER_NTAG_PAGES ? pages : READER_NTAG_PAGES;
+            reader_pages -= reader_pages % (MF_BLOCK_SIZE / NTAG_PAGE_SIZE); // whole blocks
+            reader_page = 0;
+            reader_enter(READER_PAGES);
+        } else {
+            // Ultralight and Ultralight C do not know GET_VERSION and fall back to idle:
+            // select them again, then only halt them
+            reader_plain = 1;
+            reader_again = 1;
+            reader_enter(READER_REQA);
+        }
+        break;
+    case READER_PAGES:
+        if (status == MI_OK) {
+            reader_page += reader_frame;
+            if (reader_page < reader_pages) {
+                reader_enter(READER_PAGES);
+                break;
+            }
+            reader_found->blocks = reader_pages * NTAG_PAGE_SIZE / MF_BLOCK_SIZE;
+            reader_enter(READER_HALT);
+        } else {
+            // A NAK sends the tag back to idle too
+            reader_plain = 1;
+            reader_again = 1;
+            reader_enter(READER_REQA);
+        }
+        break;
+#endif
+    default:
+        // HALT keeps this card quiet for the REQA of the rest of the sweep
+#if READER_READ_SECTOR >= 0
+        if (reader_found->sak & PICC_SAK_CLASSIC) {
+            mfrc522_stop_crypto1();
+        }
+#endif
+        reader_next(1);
+        break;
+    }
+
+    if (reader_swept) {
+        reader_swept = 0;
+        return READER_SWEEP;
+    }
+    return READER_NONE;
+}
+
+const reader_sweep_t *reader_sweep(void) {
+    return &reader_result;
+}
+
+const reader_stats_t *reader_get_stats(void) {
+    reader_field_count();
+    return &reader_stats;
+}
+
+reader_state_t reader_state(void) {
+    return reader_cur;
+}
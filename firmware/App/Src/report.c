@@ -0,0 +1,387 @@
+#include "report.h"
+#include "logger.h"
+
+#include <lwip/etharp.h>
+#include <lwip/ip_addr.h>
+#include <lwip/netif.h>
+#include <lwip/pbuf.h>
+#include <lwip/prot/dhcp.h>
+#include <lwip/udp.h>
+
+#include <malloc.h>
+#include <string.h>
+
+extern uint32_t sys_now(void);
+
+// The payload memory follows the pbuf, so lwIP prepends the UDP, IP and Ethernet
+// headers in place (PBUF_TRANSPORT room) instead of chaining a PBUF_RAM header
+// as it does for a PBUF_REF payload. pbuf_alloced_custom() starts the payload at
+// the header room rounded up to MEM_ALIGNMENT.
+typedef struct {
+    struct pbuf_custom pc; // first, the pbuf given to lwIP is the buffer itself
+    uint8_t mem[LWIP_MEM_ALIGN_SIZE(PBUF_TRANSPORT) + REPORT_DATA_MAX];
+    uint8_t busy;
+} report_buf_t;
+
+static report_buf_t report_pool[REPORT_POOL_SIZE];
+static struct udp_pcb *report_pcb = NULL;
+static report_stats_t report_stats = {0};
+static uint8_t report_id[3];
+
+static ip_addr_t report_collector;
+static uint8_t report_source = REPORT_SRC_NONE;
+static uint8_t report_arp_done = 0;
+static uint32_t report_probe_tick = 0;
+static uint8_t report_unacked = 0; // batches given up in a row
+static uint32_t report_netif_ip = 0;
+
+#if REPORT_BATCH
+static uint8_t report_batch[REPORT_DATA_MAX];
+static uint16_t report_batch_len = 0; // 0 = nothing queued
+static uint8_t report_batch_count = 0;
+static uint32_t report_batch_t0 = 0;
+static uint16_t report_seq = 0;
+#endif
+
+#if REPORT_BATCH && REPORT_RING_SIZE > 0
+typedef struct {
+    uint8_t data[REPORT_DATA_MAX];
+    uint16_t len; // 0 = free
+    uint16_t seq;
+    uint8_t tries;
+    uint32_t due;
+} report_slot_t;
+
+static report_slot_t report_ring[REPORT_RING_SIZE];
+
+static void report_ack(uint16_t seq);
+#endif
+
+// Last reference gone: sent by the ENC28J60, or dropped by ARP
+static void report_free(struct pbuf *p) {
+    ((report_buf_t *)p)->busy = 0;
+}
+
+// A better source replaces the collector, the same or a worse one does not
+static void report_set_collector(const ip_addr_t *ip, uint8_t source) {
+    if (report_source != REPORT_SRC_NONE && report_source < source) {
+        return;
+    }
+    if (report_source == source && ip_addr_cmp(&report_collector, ip)) {
+        return;
+    }
+    ip_addr_copy(report_collector, *ip);
+    report_source = source;
+    report_arp_done = 0;
+    LOG_EVENT2(LOG_EV_COLLECTOR, "collector = %08lX from %lu", lwip_ntohl(ip4_addr_get_u32(ip_2_ip4(ip))), source);
+}
+
+// A probed collector that stopped answering, or one found from an address we no
+// longer have, is probed for again right away. The configured ones stay.
+static void report_forget(void) {
+    if (report_source != REPORT_SRC_PROBE) {
+        return;
+    }
+    ip_addr_set_zero(&report_collector);
+    report_source = REPORT_SRC_NONE;
+    report_unacked = 0;
+    report_probe_tick = sys_now() - REPORT_PROBE_MS;
+    LOG_EVENT2(LOG_EV_COLLECTOR, "collector = %08lX from %lu", 0, REPORT_SRC_NONE);
+}
+
+// The collector's answers come in on the report port: HERE to a probe, ACK to a batch
+static void report_recv(void *arg, struct udp_pcb *pcb, struct pbuf *p, const ip_addr_t *addr, u16_t port) {
+    uint8_t msg[6];
+    uint16_t len = p->tot_len;
+
+    if (len >= 4 && len <= sizeof(msg) && pbuf_copy_partial(p, msg, len, 0) == len
+        && memcmp(msg, report_id, sizeof(report_id)) == 0) {
+        // only as an answer to our last probe, anyone can send a HERE
+        if (len == 4 && msg[3] == REPORT_TYPE_HERE && sys_now() - report_probe_tick < REPORT_PROBE_WAIT_MS) {
+            report_set_collector(addr, REPORT_SRC_PROBE);
+        }
+#if REPORT_BATCH && REPORT_RING_SIZE > 0
+        if (len == 6 && msg[3] == REPORT_TYPE_ACK) {
+            report_ack(msg[4] << 8 | msg[5]);
+        }
+#endif
+    }
+    pbuf_free(p);
+}
+
+void report_dhcp_option(uint8_t msg_type, uint8_t option, uint8_t len, struct pbuf *p, uint16_t offset) {
+    ip_addr_t ip;
+
+    // Only the ACK of the lease we take: offers come from every server on the
+    // segment. lwIP passes the type parsed so far, so servers have to send option 53
+    // before ours, which they do.
+    if (option != REPORT_DHCP_OPTION || len != 4 || msg_type != DHCP_ACK) {
+        return;
+    }
+    if (pbuf_copy_partial(p, &ip4_addr_get_u32(ip_2_ip4(&ip)), 4, offset) == 4 && !ip_addr_isany_val(ip)) {
+        report_set_collector(&ip, REPORT_SRC_DHCP);
+    }
+}
+
+void report_init(const uint8_t *id) {
+    memcpy(report_id, id, sizeof(report_id));
+    for (int i = 0; i < REPORT_POOL_SIZE; i++) {
+        report_pool[i].pc.custom_free_function = report_free;
+        report_pool[i].busy = 0;
+    }
+
+    ip_addr_t ip;
+    if (ipaddr_aton(REPORT_COLLECTOR_IP, &ip)) {
+        report_set_collector(&ip, REPORT_SRC_STATIC);
+    }
+    report_probe_tick = sys_now() - REPORT_PROBE_MS; // first probe as soon as we have an address
+
+    report_pcb = udp_new();
+    if (report_pcb == NULL) {
+        LOG_EVENT0(LOG_EV_UDP_NO_PCB, "udp_new failed");
+        return;
+    }
+    // the collector answers to the port the probe came from
+    udp_bind(report_pcb, IP_ADDR_ANY, REPORT_PORT);
+    udp_recv(report_pcb, report_recv, NULL);
+}
+
+// Before the first report goes out: probe for the collector, or fill the ARP
+// cache with the next hop so that report is not held up by an ARP round trip
+static void report_discover(void) {
+    struct netif *netif = netif_default;
+    uint32_t ip = netif != NULL ? ip4_addr_get_u32(netif_ip4_addr(netif)) : 0;
+
+    // a new lease, or none: the collector we probed may not be there any more
+    if (ip != report_netif_ip) {
+        report_netif_ip = ip;
+        report_forget();
+        report_arp_done = 0;
+    }
+    if (ip == 0) {
+        return;
+    }
+
+    if (report_source == REPORT_SRC_NONE) {
+        if (sys_now() - report_probe_tick >= REPORT_PROBE_MS) {
+            uint8_t probe[4];
+            memcpy(probe, report_id, sizeof(report_id));
+            probe[3] = REPORT_TYPE_PROBE;
+            report_probe_tick = sys_now();
+            report_send(probe, sizeof(probe));
+        }
+    } else if (!report_arp_done) {
+        const ip4_addr_t *hop = ip_2_ip4(&report_collector);
+        if (!ip4_addr_netcmp(hop, netif_ip4_addr(netif), netif_ip4_netmask(netif))) {
+            hop = netif_ip4_gw(netif);
+        }
+        etharp_query(netif, hop, NULL);
+        report_arp_done = 1;
+    }
+}
+
+uint8_t report_send(const uint8_t *data, uint16_t len) {
+    report_buf_t *buf = NULL;
+
+    if (report_pcb == NULL || len > REPORT_DATA_MAX) {
+        return REPORT_ERR;
+    }
+
+    for (int i = 0; i < REPORT_POOL_SIZE && buf == NULL; i++) {
+        if (!report_pool[i].busy) {
+            buf = &report_pool[i];
+        }
+    }
+    if (buf == NULL) {
+        report_stats.busy++;
+        LOG_EVENT0(LOG_EV_UDP_NO_PBUF, "no free report buffer");
+        return REPORT_BUSY;
+    }
+
+    struct pbuf *p = pbuf_alloced_custom(PBUF_TRANSPORT, len, PBUF_RAM, &buf->pc, buf->mem, sizeof(buf->mem));
+    if (p == NULL) {
+        report_stats.failed++;
+        LOG_EVENT1(LOG_EV_REPORT_PBUF, "report pbuf for %lu bytes failed", len);
+        return REPORT_ERR;
+    }
+    buf->busy = 1;
+    memcpy(p->payload, data, len);
+
+    const ip_addr_t *dest_ip = report_source != REPORT_SRC_NONE ? &report_collector : IP_ADDR_BROADCAST;
+    err_t err = udp_sendto(report_pcb, p, dest_ip, REPORT_PORT);
+    if (err != ERR_OK) {
+        LOG_EVENT1(LOG_EV_UDP_ERR, "udp_sendto err: %ld", err);
+    } else {
+        report_stats.sent++;
+    }
+    pbuf_free(p); // the buffer comes back once lwIP and the driver let go too
+
+    return err == ERR_OK ? REPORT_OK : REPORT_ERR;
+}
+
+#if REPORT_BATCH
+void report_event(uint8_t type, const uint8_t *payload, uint8_t len) {
+    uint32_t now = sys_now();
+
+    // an empty batch still has its header to write
+    if ((report_batch_len ? report_batch_len : REPORT_EVENTS_HLEN) + 4 + len > REPORT_DATA_MAX) {
+        report_flush();
+        if (REPORT_EVENTS_HLEN + 4 + len > REPORT_DATA_MAX) {
+            report_stats.dropped++;
+            LOG_EVENT2(LOG_EV_REPORT_BIG, "event %lu of %lu bytes too big", type, len);
+            return;
+        }
+    }
+
+    if (report_batch_len == 0) {
+        memcpy(report_batch, report_id, sizeof(report_id));
+        report_batch[3] = REPORT_TYPE_EVENTS;
+        report_batch[4] = REPORT_EVENTS_VER;
+        report_batch[8] = now >> 24;
+        report_batch[9] = now >> 16;
+        report_batch[10] = now >> 8;
+        report_batch[11] = now;
+        report_batch_len = REPORT_EVENTS_HLEN;
+        report_batch_count = 0;
+        report_batch_t0 = now;
+    }
+
+    uint16_t dt = now - report_batch_t0;
+    uint8_t *ev = &report_batch[report_batch_len];
+    ev[0] = dt >> 8;
+    ev[1] = dt;
+    ev[2] = type;
+    ev[3] = len;
+    memcpy(&ev[4], payload, len);
+    report_batch_len += 4 + len;
+    report_batch_count++;
+    report_stats.events++;
+
+    if (report_batch_count == REPORT_BATCH_EVENTS) {
+        report_flush();
+    }
+}
+
+#if REPORT_RING_SIZE > 0
+static void report_drop(report_slot_t *slot) {
+    report_stats.lost++;
+    LOG_EVENT2(LOG_EV_REPORT_LOST, "report %lu lost after %lu tries", slot->seq, slot->tries);
+    slot->len = 0;
+}
+
+// Keep a copy of the batch until its ACK, the oldest one makes room when the ring is full
+static void report_keep(const uint8_t *data, uint16_t len, uint16_t seq) {
+    report_slot_t *slot = NULL;
+
+    for (int i = 0; i < REPORT_RING_SIZE; i++) {
+        report_slot_t *s = &report_ring[i];
+        if (s->len == 0) {
+            slot = s;
+            break;
+        }
+        if (slot == NULL || (int16_t)(s->seq - slot->seq) < 0) {
+            slot = s;
+        }
+    }
+    if (slot->len != 0) {
+        report_drop(slot);
+    }
+
+    memcpy(slot->data, data, len);
+    slot->len = len;
+    slot->seq = seq;
+    slot->tries = 0;
+    slot->due = sys_now() + REPORT_RETRY_MS;
+}
+
+static void report_ack(uint16_t seq) {
+    for (int i = 0; i < REPORT_RING_SIZE; i++) {
+        if (report_ring[i].len != 0 && report_ring[i].seq == seq) {
+            report_ring[i].len = 0;
+            report_stats.acked++;
+            report_unacked = 0;
+        }
+    }
+}
+
+// Send again what is due, waiting twice as long after each try
+static void report_resend(void) {
+    uint32_t now = sys_now();
+
+    for (int i = 0; i < REPORT_RING_SIZE; i++) {
+        report_slot_t *slot = &report_ring[i];
+        if (slot->len == 0 || (int32_t)(now - slot->due) < 0) {
+            continue;
+        }
+        if (slot->tries == REPORT_RETRIES) {
+            report_drop(slot);
+            if (++report_unacked == REPORT_PROBE_LOST) {
+                report_forget();
+            }
+            continue;
+        }
+        if (report_send(slot->data, slot->len) == REPORT_BUSY) {
+            slot->due = now + REPORT_RETRY_MS; // buffers still in flight, not a try
+            continue;
+        }
+        slot->tries++; // a send that failed for good counts, so the batch ends up LOST
+        report_stats.retries++;
+        uint32_t wait = (uint32_t)REPORT_RETRY_MS << slot->tries;
+        slot->due = now + (wait < REPORT_RETRY_MAX_MS ? wait : REPORT_RETRY_MAX_MS);
+    }
+}
+#endif
+
+void report_flush(void) {
+    if (report_batch_len == 0) {
+        return;
+    }
+    report_batch[5] = report_batch_count;
+    report_batch[6] = report_seq >> 8;
+    report_batch[7] = report_seq;
+#if REPORT_RING_SIZE > 0
+    report_keep(report_batch, report_batch_len, report_seq);
+#endif
+    report_seq++;
+    report_send(report_batch, report_batch_len);
+    report_batch_len = 0;
+}
+
+void report_poll(void) {
+    report_discover();
+    if (report_batch_len != 0 && sys_now() - report_batch_t0 >= REPORT_BATCH_MS) {
+        report_flush();
+    }
+#if REPORT_RING_SIZE > 0
+    report_resend();
+#endif
+}
+#else
+// Every event is its own datagram: [ID0][ID1][ID2][type][payload]
+void report_event(uint8_t type, const uint8_t *payload, uint8_t len) {
+    uint8_t msg[4 + 255];
+
+    memcpy(msg, report_id, sizeof(report_id));
+    msg[3] = type;
+    memcpy(&msg[4], payload, len);
+    report_send(msg, 4 + len);
+}
+
+void report_flush(void) {
+}
+
+void report_poll(void) {
+    report_discover();
+}
+#endif
+
+const report_stats_t *report_get_stats(void) {
+    return &report_stats;
+}
+
+void report_heap(uint32_t *used, uint32_t *peak) {
+    struct mallinfo mi = mallinfo();
+
+    *used = mi.uordblks;
+    *peak = mi.arena; // newlib never gives sbrk memory back
+}
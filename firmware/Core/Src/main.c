@@ -22,6 +22,7 @@
 /* Private includes ----------------------------------------------------------*/
 /* USER CODE BEGIN Includes */
 #include "app.h"
+#include "logger.h"
 /* USER CODE END Includes */
 
 /* Private typedef -----------------------------------------------------------*/
@@ -59,13 +60,8 @@ static void MX_USART1_UART_Init(void);
 /* USER CODE BEGIN 0 */
 int _write(int file, char *ptr, int len)
 {
-  for(int i = 0; i < len; i++)
-  {
-    while (!(LL_USART_IsActiveFlag_TXE(USART1)))
-      ;
-    LL_USART_TransmitData8(USART1, *ptr++);
-  }
-  return len;
+  /* queued, USART1 interrupt sends it out */
+  return logger_write(ptr, len);
 }
 /* USER CODE END 0 */
 
@@ -326,6 +322,7 @@ static void MX_USART1_UART_Init(void)
   LL_USART_ConfigAsyncMode(USART1);
   LL_USART_Enable(USART1);
   /* USER CODE BEGIN USART1_Init 2 */
+  logger_init();
 
   /* USER CODE END USART1_Init 2 */
 
@@ -22,6 +22,8 @@
 #include "stm32f1xx_it.h"
 /* Private includes ----------------------------------------------------------*/
 /* USER CODE BEGIN Includes */
+#include "enc28j60.h"
+#include "logger.h"
 /* USER CODE END Includes */
 
 /* Private typedef -----------------------------------------------------------*/
@@ -199,5 +201,35 @@ void SysTick_Handler(void)
 /******************************************************************************/
 
 /* USER CODE BEGIN 1 */
+/**
+  * @brief This function handles DMA1 channel4 global interrupt (SPI2_RX).
+  */
+void DMA1_Channel4_IRQHandler(void)
+{
+  enc28j60_dma_irq();
+}
+
+/**
+  * @brief This function handles EXTI line[9:5] interrupts (ETH_IRQ).
+  */
+void EXTI9_5_IRQHandler(void)
+{
+  if (LL_EXTI_IsActiveFlag_0_31(LL_EXTI_LINE_8) != RESET)
+  {
+    LL_EXTI_ClearFlag_0_31(LL_EXTI_LINE_8);
+    enc28j60_irq();
+  }
+}
+
+/**
+  * @brief This function handles USART1 global interrupt (log output).
+  */
+void USART1_IRQHandler(void)
+{
+  if (LL_USART_IsEnabledIT_TXE(USART1) && LL_USART_IsActiveFlag_TXE(USART1))
+  {
+    logger_irq();
+  }
+}
 
 /* USER CODE END 1 */
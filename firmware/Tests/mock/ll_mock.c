@@ -0,0 +1,248 @@
+#include "ll_mock.h"
+#include "enc28j60.h"
+#include "main.h"
+
+#include <string.h>
+
+SPI_TypeDef mock_spi1 = {1}, mock_spi2 = {2};
+DMA_TypeDef mock_dma1 = {1};
+USART_TypeDef mock_usart1 = {1};
+GPIO_TypeDef mock_gpio_irq = {0}, mock_gpio_rfid = {0};
+mock_enc_t mock_enc;
+mock_uart_t mock_uart;
+void (*mock_dma1_ch4_irq)(void) = 0;
+
+static GPIO_TypeDef mock_gpio_nss = {GPIO_BSRR_BS12};
+static uint8_t mock_nss_written = 0; // CS written since the last byte
+static uint32_t mock_frame_pos = 0;
+static uint8_t mock_spi_rx = 0;
+
+typedef struct {
+    uint32_t config;
+    uint32_t addr;
+    uint32_t len;
+    uint8_t enabled;
+} mock_dma_ch_t;
+
+static mock_dma_ch_t mock_dma_ch[8];
+static uint8_t mock_dma_req_rx = 0;
+static uint32_t mock_dma_flags = 0; // TC4
+
+void mock_enc_reset(void) {
+    memset(&mock_enc, 0, sizeof(mock_enc));
+    memset(mock_dma_ch, 0, sizeof(mock_dma_ch));
+    mock_gpio_nss.BSRR = GPIO_BSRR_BS12;
+    mock_nss_written = 0;
+    mock_dma_req_rx = 0;
+    mock_dma_flags = 0;
+}
+
+uint8_t mock_enc_selected(void) {
+    return mock_gpio_nss.BSRR == GPIO_BSRR_BR12;
+}
+
+GPIO_TypeDef *mock_eth_nss(void) {
+    mock_nss_written = 1;
+    return &mock_gpio_nss;
+}
+
+// One byte each way on SPI2, the ENC28J60 side
+static uint8_t mock_enc_xfer(uint8_t tx) {
+    if (mock_nss_written) {
+        mock_nss_written = 0;
+        if (mock_enc_selected()) {
+            mock_enc.frames++;
+            mock_frame_pos = 0;
+        }
+    }
+    if (!mock_enc_selected()) {
+        mock_enc.errors++;
+        return 0xFF;
+    }
+
+    if (mock_frame_pos++ == 0) {
+        mock_enc.opcode = tx;
+        return 0x00;
+    }
+    mock_enc.bytes++;
+    switch (mock_enc.opcode) {
+    case ENC28J60_SPI_RBM:
+        return mock_enc.mem[mock_enc.rdpt++ % MOCK_ENC_MEMSIZE];
+    case ENC28J60_SPI_WBM:
+        mock_enc.mem[mock_enc.wrpt++ % MOCK_ENC_MEMSIZE] = tx;
+        return 0x00;
+    default:
+        return 0x00;
+    }
+}
+
+/*
+ * SPI
+ */
+
+void LL_SPI_Enable(SPI_TypeDef *spi) {
+    (void)spi;
+}
+
+uint32_t LL_SPI_IsActiveFlag_TXE(SPI_TypeDef *spi) {
+    (void)spi;
+    return 1;
+}
+
+uint32_t LL_SPI_IsActiveFlag_RXNE(SPI_TypeDef *spi) {
+    (void)spi;
+    return 1;
+}
+
+void LL_SPI_TransmitData8(SPI_TypeDef *spi, uint8_t data) {
+    mock_spi_rx = (spi == SPI2) ? mock_enc_xfer(data) : 0x00;
+}
+
+uint8_t LL_SPI_ReceiveData8(SPI_TypeDef *spi) {
+    (void)spi;
+    return mock_spi_rx;
+}
+
+uint32_t LL_SPI_DMA_GetRegAddr(SPI_TypeDef *spi) {
+    (void)spi;
+    return 0;
+}
+
+void LL_SPI_EnableDMAReq_RX(SPI_TypeDef *spi) {
+    (void)spi;
+    mock_dma_req_rx = 1;
+}
+
+// Tx request on: SPI2 clocks the whole burst, Rx channel 4 then raises TC
+void LL_SPI_EnableDMAReq_TX(SPI_TypeDef *spi) {
+    mock_dma_ch_t *rx = &mock_dma_ch[LL_DMA_CHANNEL_4];
+    mock_dma_ch_t *tx = &mock_dma_ch[LL_DMA_CHANNEL_5];
+
+    (void)spi;
+    // Rx must be armed first or the first bytes overrun
+    if (!rx->enabled || !mock_dma_req_rx || !tx->enabled || rx->len != tx->len) {
+        mock_enc.errors++;
+        return;
+    }
+
+    uint8_t *rxmem = (uint8_t *)(uintptr_t)rx->addr;
+    const uint8_t *txmem = (const uint8_t *)(uintptr_t)tx->addr;
+    for (uint32_t i = 0; i < tx->len; i++) {
+        uint8_t b = mock_enc_xfer((tx->config & LL_DMA_MEMORY_INCREMENT) ? txmem[i] : txmem[0]);
+        if (rx->config & LL_DMA_MEMORY_INCREMENT) {
+            rxmem[i] = b;
+        } else {
+            rxmem[0] = b;
+        }
+    }
+    mock_enc.bursts++;
+    mock_dma_flags = 1;
+    if (mock_dma1_ch4_irq) {
+        mock_dma1_ch4_irq();
+    }
+}
+
+void LL_SPI_DisableDMAReq_RX(SPI_TypeDef *spi) {
+    (void)spi;
+    mock_dma_req_rx = 0;
+}
+
+void LL_SPI_DisableDMAReq_TX(SPI_TypeDef *spi) {
+    (void)spi;
+}
+
+/*
+ * DMA
+ */
+
+void LL_DMA_ConfigTransfer(DMA_TypeDef *dma, uint32_t ch, uint32_t config) {
+    (void)dma;
+    mock_dma_ch[ch].config = config;
+}
+
+void LL_DMA_SetPeriphAddress(DMA_TypeDef *dma, uint32_t ch, uint32_t addr) {
+    (void)dma;
+    (void)ch;
+    (void)addr;
+}
+
+void LL_DMA_SetMemoryAddress(DMA_TypeDef *dma, uint32_t ch, uint32_t addr) {
+    (void)dma;
+    mock_dma_ch[ch].addr = addr;
+}
+
+void LL_DMA_SetDataLength(DMA_TypeDef *dma, uint32_t ch, uint32_t len) {
+    (void)dma;
+    mock_dma_ch[ch].len = len;
+}
+
+void LL_DMA_EnableChannel(DMA_TypeDef *dma, uint32_t ch) {
+    (void)dma;
+    mock_dma_ch[ch].enabled = 1;
+}
+
+void LL_DMA_DisableChannel(DMA_TypeDef *dma, uint32_t ch) {
+    (void)dma;
+    mock_dma_ch[ch].enabled = 0;
+}
+
+void LL_DMA_EnableIT_TC(DMA_TypeDef *dma, uint32_t ch) {
+    (void)dma;
+    (void)ch;
+}
+
+void LL_DMA_EnableIT_TE(DMA_TypeDef *dma, uint32_t ch) {
+    (void)dma;
+    (void)ch;
+}
+
+uint32_t LL_DMA_IsActiveFlag_TC4(DMA_TypeDef *dma) {
+    (void)dma;
+    return mock_dma_flags;
+}
+
+uint32_t LL_DMA_IsActiveFlag_TE4(DMA_TypeDef *dma) {
+    (void)dma;
+    return 0;
+}
+
+void LL_DMA_ClearFlag_GI4(DMA_TypeDef *dma) {
+    (void)dma;
+    mock_dma_flags = 0;
+}
+
+void LL_DMA_ClearFlag_GI5(DMA_TypeDef *dma) {
+    (void)dma;
+}
+
+/*
+ * GPIO
+ */
+
+uint32_t LL_GPIO_IsInputPinSet(GPIO_TypeDef *port, uint32_t pin) {
+    (void)port;
+    (void)pin;
+    return 1; // INT idle high
+}
+
+/*
+ * USART
+ */
+
+void LL_USART_EnableIT_TXE(USART_TypeDef *usart) {
+    (void)usart;
+    mock_uart.txe_irq = 1;
+}
+
+void LL_USART_DisableIT_TXE(USART_TypeDef *usart) {
+    (void)usart;
+    mock_uart.txe_irq = 0;
+}
+
+void LL_USART_TransmitData8(USART_TypeDef *usart, uint8_t data) {
+    (void)usart;
+    if (mock_uart.len < MOCK_UART_MAXLEN) {
+        mock_uart.out[mock_uart.len] = data;
+    }
+    mock_uart.len++;
+}
@@ -0,0 +1,39 @@
+#ifndef __LL_MOCK_H
+#define __LL_MOCK_H
+
+#include <stdint.h>
+
+// ENC28J60 model behind SPI2: buffer memory with RBM/WBM and their pointers
+#define MOCK_ENC_MEMSIZE 0x2000
+
+typedef struct {
+    uint8_t mem[MOCK_ENC_MEMSIZE];
+    uint16_t rdpt;   // ERDPT
+    uint16_t wrpt;   // EWRPT
+    uint32_t frames; // CS frames
+    uint32_t bytes;  // bytes clocked after the opcode
+    uint32_t bursts; // DMA transfers
+    uint32_t errors; // bytes clocked with CS high, DMA started in the wrong order
+    uint8_t opcode;  // first byte of the last frame
+} mock_enc_t;
+
+extern mock_enc_t mock_enc;
+
+// DMA1 channel 4 vector, the test points it at the driver's handler
+extern void (*mock_dma1_ch4_irq)(void);
+
+void mock_enc_reset(void);
+uint8_t mock_enc_selected(void);
+
+// USART1: what went out on Tx and whether the TXE interrupt is on
+#define MOCK_UART_MAXLEN 0x2000
+
+typedef struct {
+    uint8_t out[MOCK_UART_MAXLEN];
+    uint32_t len;
+    uint8_t txe_irq;
+} mock_uart_t;
+
+extern mock_uart_t mock_uart;
+
+#endif // __LL_MOCK_H
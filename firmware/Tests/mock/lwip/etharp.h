@@ -0,0 +1,8 @@
+#ifndef LWIP_HDR_NETIF_ETHARP_H
+#define LWIP_HDR_NETIF_ETHARP_H
+
+#include "lwip/netif.h"
+
+err_t etharp_query(struct netif *netif, const ip4_addr_t *ipaddr, struct pbuf *q);
+
+#endif // LWIP_HDR_NETIF_ETHARP_H
@@ -0,0 +1,27 @@
+#ifndef LWIP_HDR_IP_ADDR_H
+#define LWIP_HDR_IP_ADDR_H
+
+#include "lwip/opt.h"
+
+typedef struct {
+    u32_t addr; // network order
+} ip4_addr_t;
+typedef ip4_addr_t ip_addr_t;
+
+extern const ip_addr_t ip_addr_any, ip_addr_broadcast;
+
+#define IP_ADDR_ANY       (&ip_addr_any)
+#define IP_ADDR_BROADCAST (&ip_addr_broadcast)
+
+#define ip_2_ip4(ip)                       (ip)
+#define ip4_addr_get_u32(ip)               ((ip)->addr)
+#define ip_addr_copy(dest, src)            ((dest) = (src))
+#define ip_addr_set_zero(ip)               ((ip)->addr = 0)
+#define ip_addr_cmp(a, b)                  ((a)->addr == (b)->addr)
+#define ip_addr_isany_val(ip)              ((ip).addr == 0)
+#define ip4_addr_isany_val(ip)             ((ip).addr == 0)
+#define ip4_addr_netcmp(a, b, mask)        (((a)->addr & (mask)->addr) == ((b)->addr & (mask)->addr))
+
+int ipaddr_aton(const char *cp, ip_addr_t *addr);
+
+#endif // LWIP_HDR_IP_ADDR_H
@@ -0,0 +1,19 @@
+#ifndef LWIP_HDR_NETIF_H
+#define LWIP_HDR_NETIF_H
+
+#include "lwip/ip_addr.h"
+#include "lwip/pbuf.h"
+
+struct netif {
+    ip_addr_t ip_addr;
+    ip_addr_t netmask;
+    ip_addr_t gw;
+};
+
+extern struct netif *netif_default;
+
+#define netif_ip4_addr(netif)    ((const ip4_addr_t *)&(netif)->ip_addr)
+#define netif_ip4_netmask(netif) ((const ip4_addr_t *)&(netif)->netmask)
+#define netif_ip4_gw(netif)      ((const ip4_addr_t *)&(netif)->gw)
+
+#endif // LWIP_HDR_NETIF_H
@@ -0,0 +1,26 @@
+#ifndef LWIP_HDR_OPT_H
+#define LWIP_HDR_OPT_H
+
+// Host stand-in for the lwIP 2.1 headers report.c uses: the types, constants and
+// macros it needs, with the values of lwipopts.h and the IPv4-only build
+
+#include <stddef.h>
+#include <stdint.h>
+
+typedef uint8_t u8_t;
+typedef uint16_t u16_t;
+typedef int16_t s16_t;
+typedef uint32_t u32_t;
+typedef int32_t s32_t;
+typedef int8_t err_t;
+
+#define ERR_OK  0
+#define ERR_MEM -1
+#define ERR_RTE -4
+
+#define MEM_ALIGNMENT          4
+#define LWIP_MEM_ALIGN_SIZE(s) (((s) + MEM_ALIGNMENT - 1U) & ~(MEM_ALIGNMENT - 1U))
+
+u32_t lwip_ntohl(u32_t n);
+
+#endif // LWIP_HDR_OPT_H
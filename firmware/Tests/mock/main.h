@@ -0,0 +1,126 @@
+#ifndef __MAIN_H
+#define __MAIN_H
+
+// Host stand-in for Core/Inc/main.h: the CMSIS and LL pieces the App drivers use,
+// backed by the SPI/DMA model in ll_mock.c
+
+#include <stdint.h>
+
+typedef struct {
+    volatile uint32_t BSRR;
+} GPIO_TypeDef;
+
+typedef struct {
+    int id;
+} SPI_TypeDef;
+
+typedef struct {
+    int id;
+} DMA_TypeDef;
+
+typedef struct {
+    int id;
+} USART_TypeDef;
+
+extern SPI_TypeDef mock_spi1, mock_spi2;
+extern DMA_TypeDef mock_dma1;
+extern USART_TypeDef mock_usart1;
+extern GPIO_TypeDef mock_gpio_irq, mock_gpio_rfid;
+
+// Every write to ENC28J60 CS goes through here, so the model sees each frame start
+GPIO_TypeDef *mock_eth_nss(void);
+
+#define SPI1 (&mock_spi1)
+#define SPI2 (&mock_spi2)
+#define DMA1 (&mock_dma1)
+#define USART1 (&mock_usart1)
+
+#define ETH_NSS_GPIO_Port  mock_eth_nss()
+#define ETH_IRQ_GPIO_Port  (&mock_gpio_irq)
+#define ETH_IRQ_Pin        (1u << 8)
+#define RFID_NSS_GPIO_Port (&mock_gpio_rfid)
+#define RFID_RST_GPIO_Port (&mock_gpio_rfid)
+
+#define GPIO_BSRR_BS4  (1u << 4)
+#define GPIO_BSRR_BR4  (1u << 20)
+#define GPIO_BSRR_BS11 (1u << 11)
+#define GPIO_BSRR_BR11 (1u << 27)
+#define GPIO_BSRR_BS12 (1u << 12)
+#define GPIO_BSRR_BR12 (1u << 28)
+
+/*
+ * NVIC and clocks, nothing to do on the host
+ */
+
+#define DMA1_Channel4_IRQn 14
+#define EXTI9_5_IRQn       23
+#define USART1_IRQn        37
+
+#define NVIC_SetPriority(irq, prio)            ((void)(irq), (void)(prio))
+#define NVIC_EnableIRQ(irq)                    ((void)(irq))
+#define NVIC_GetPriorityGrouping()             0u
+#define NVIC_EncodePriority(group, prio, sub)  ((void)(group), (void)(prio), (void)(sub), 0u)
+#define LL_AHB1_GRP1_PERIPH_DMA1               (1u << 0)
+#define LL_AHB1_GRP1_EnableClock(periph)       ((void)(periph))
+#define LL_mDelay(ms)                          ((void)(ms))
+
+/*
+ * SPI
+ */
+
+void LL_SPI_Enable(SPI_TypeDef *spi);
+uint32_t LL_SPI_IsActiveFlag_TXE(SPI_TypeDef *spi);
+uint32_t LL_SPI_IsActiveFlag_RXNE(SPI_TypeDef *spi);
+void LL_SPI_TransmitData8(SPI_TypeDef *spi, uint8_t data);
+uint8_t LL_SPI_ReceiveData8(SPI_TypeDef *spi);
+uint32_t LL_SPI_DMA_GetRegAddr(SPI_TypeDef *spi);
+void LL_SPI_EnableDMAReq_RX(SPI_TypeDef *spi);
+void LL_SPI_EnableDMAReq_TX(SPI_TypeDef *spi);
+void LL_SPI_DisableDMAReq_RX(SPI_TypeDef *spi);
+void LL_SPI_DisableDMAReq_TX(SPI_TypeDef *spi);
+
+/*
+ * DMA, the values of the STM32F1 LL headers where the model looks at them
+ */
+
+#define LL_DMA_CHANNEL_4                  4u
+#define LL_DMA_CHANNEL_5                  5u
+#define LL_DMA_DIRECTION_PERIPH_TO_MEMORY 0x00u
+#define LL_DMA_DIRECTION_MEMORY_TO_PERIPH 0x10u
+#define LL_DMA_MODE_NORMAL                0x00u
+#define LL_DMA_PERIPH_NOINCREMENT         0x00u
+#define LL_DMA_MEMORY_NOINCREMENT         0x00u
+#define LL_DMA_MEMORY_INCREMENT           0x80u
+#define LL_DMA_PDATAALIGN_BYTE            0x00u
+#define LL_DMA_MDATAALIGN_BYTE            0x00u
+#define LL_DMA_PRIORITY_HIGH              0x2000u
+#define LL_DMA_PRIORITY_VERYHIGH          0x3000u
+
+void LL_DMA_ConfigTransfer(DMA_TypeDef *dma, uint32_t ch, uint32_t config);
+void LL_DMA_SetPeriphAddress(DMA_TypeDef *dma, uint32_t ch, uint32_t addr);
+void LL_DMA_SetMemoryAddress(DMA_TypeDef *dma, uint32_t ch, uint32_t addr);
+void LL_DMA_SetDataLength(DMA_TypeDef *dma, uint32_t ch, uint32_t len);
+void LL_DMA_EnableChannel(DMA_TypeDef *dma, uint32_t ch);
+void LL_DMA_DisableChannel(DMA_TypeDef *dma, uint32_t ch);
+void LL_DMA_EnableIT_TC(DMA_TypeDef *dma, uint32_t ch);
+void LL_DMA_EnableIT_TE(DMA_TypeDef *dma, uint32_t ch);
+uint32_t LL_DMA_IsActiveFlag_TC4(DMA_TypeDef *dma);
+uint32_t LL_DMA_IsActiveFlag_TE4(DMA_TypeDef *dma);
+void LL_DMA_ClearFlag_GI4(DMA_TypeDef *dma);
+void LL_DMA_ClearFlag_GI5(DMA_TypeDef *dma);
+
+/*
+ * GPIO
+ */
+
+uint32_t LL_GPIO_IsInputPinSet(GPIO_TypeDef *port, uint32_t pin);
+
+/*
+ * USART
+ */
+
+void LL_USART_EnableIT_TXE(USART_TypeDef *usart);
+void LL_USART_DisableIT_TXE(USART_TypeDef *usart);
+void LL_USART_TransmitData8(USART_TypeDef *usart, uint8_t data);
+
+#endif // __MAIN_H
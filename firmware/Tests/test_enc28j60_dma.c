@@ -0,0 +1,115 @@
+// ENC28J60 buffer transfers on the SPI/DMA model: byte order, length and CS framing
+// around ENC28J60_DMA_MINLEN, for the DMA calls and the polled ones that pick DMA
+
+#include "enc28j60.h"
+#include "ll_mock.h"
+
+#include <stdio.h>
+#include <string.h>
+
+#define MAXLEN 1518
+#define GUARD  0xA5
+#define MEMPOS 0x0100
+
+static const uint16_t lengths[] = {0, 1, ENC28J60_DMA_MINLEN - 1, ENC28J60_DMA_MINLEN, ENC28J60_DMA_MINLEN + 1, MAXLEN};
+
+// Static, so below 4 GB in the non-PIE test binary like the driver's (uint32_t) DMA addresses need
+static uint8_t out[MAXLEN];
+static uint8_t in[MAXLEN + 1];
+static int callbacks = 0;
+static int failures = 0;
+
+#define CHECK(cond, len, what)                                      \
+    do {                                                            \
+        if (!(cond)) {                                              \
+            printf("FAIL len %u: %s\n", (unsigned)(len), what);     \
+            failures++;                                             \
+        }                                                           \
+    } while (0)
+
+static void done(void) {
+    callbacks++;
+}
+
+static void fill(uint16_t len) {
+    for (uint16_t i = 0; i < len; i++) {
+        out[i] = (uint8_t)(i * 7 + len);
+    }
+    memset(in, GUARD, sizeof(in));
+}
+
+// WBM or RBM frames with the opcode first and exactly len bytes, CS high after them
+static void check_frame(uint16_t len, uint8_t opcode, uint32_t frames, uint32_t bursts) {
+    CHECK(mock_enc.errors == 0, len, "SPI traffic outside a frame or DMA misordered");
+    CHECK(mock_enc.frames == frames, len, "CS frames");
+    CHECK(frames == 0 || mock_enc.opcode == opcode, len, "opcode");
+    CHECK(mock_enc.bytes == len, len, "bytes after the opcode");
+    CHECK(mock_enc.bursts == bursts, len, "DMA bursts");
+    CHECK(!mock_enc_selected(), len, "CS released");
+    CHECK(!enc28j60_dma_busy(), len, "DMA idle");
+}
+
+static void test_dma(uint16_t len) {
+    fill(len);
+
+    mock_enc_reset();
+    mock_enc.wrpt = MEMPOS;
+    callbacks = 0;
+    enc28j60_write_buffer_dma(out, len, done);
+    check_frame(len, ENC28J60_SPI_WBM, len ? 1 : 0, len ? 1 : 0);
+    CHECK(callbacks == 1, len, "write callback once");
+    CHECK(mock_enc.wrpt == MEMPOS + len, len, "EWRPT advance");
+    CHECK(memcmp(&mock_enc.mem[MEMPOS], out, len) == 0, len, "written bytes in order");
+
+    uint8_t mem[MOCK_ENC_MEMSIZE];
+    memcpy(mem, mock_enc.mem, sizeof(mem));
+    mock_enc_reset();
+    memcpy(mock_enc.mem, mem, sizeof(mem));
+    mock_enc.rdpt = MEMPOS;
+    callbacks = 0;
+    enc28j60_read_buffer_dma(in, len, done);
+    check_frame(len, ENC28J60_SPI_RBM, len ? 1 : 0, len ? 1 : 0);
+    CHECK(callbacks == 1, len, "read callback once");
+    CHECK(mock_enc.rdpt == MEMPOS + len, len, "ERDPT advance");
+    CHECK(memcmp(in, out, len) == 0, len, "read bytes in order");
+    CHECK(in[len] == GUARD, len, "nothing past the end");
+}
+
+// enc28j60_read_buffer/write_buffer: DMA from ENC28J60_DMA_MINLEN on, polled below.
+// A polled zero-length transfer still sends its opcode frame.
+static void test_polled(uint16_t len) {
+    uint32_t bursts = (len >= ENC28J60_DMA_MINLEN) ? 1 : 0;
+
+    fill(len);
+
+    mock_enc_reset();
+    mock_enc.wrpt = MEMPOS;
+    enc28j60_write_buffer(out, len);
+    check_frame(len, ENC28J60_SPI_WBM, 1, bursts);
+    CHECK(memcmp(&mock_enc.mem[MEMPOS], out, len) == 0, len, "written bytes in order");
+
+    mock_enc.rdpt = MEMPOS;
+    mock_enc.frames = 0;
+    mock_enc.bytes = 0;
+    mock_enc.bursts = 0;
+    enc28j60_read_buffer(in, len);
+    check_frame(len, ENC28J60_SPI_RBM, 1, bursts);
+    CHECK(memcmp(in, out, len) == 0, len, "read bytes in order");
+    CHECK(in[len] == GUARD, len, "nothing past the end");
+}
+
+int main(void) {
+    if ((uintptr_t)out > UINT32_MAX || (uintptr_t)in > UINT32_MAX) {
+        printf("FAIL: buffers above 4 GB, build without PIE\n");
+        return 1;
+    }
+    mock_dma1_ch4_irq = enc28j60_dma_irq;
+
+    for (unsigned i = 0; i < sizeof(lengths) / sizeof(lengths[0]); i++) {
+        test_dma(lengths[i]);
+        test_polled(lengths[i]);
+    }
+
+    printf("%s\n", failures ? "FAILED" : "OK");
+    return failures != 0;
+}
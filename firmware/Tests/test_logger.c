@@ -0,0 +1,113 @@
+// Log ring on the USART1 model: a write that does not fit is dropped whole and
+// counted, so what goes out is always whole records and lines, across the wrap too
+
+#include "logger.h"
+#include "ll_mock.h"
+
+#include <stdio.h>
+#include <string.h>
+
+#define RECLEN (4 + 4 * LOGGER_RECORD_ARGS)
+
+static uint32_t now = 0;
+static int failures = 0;
+
+#define CHECK(cond, n, what)                                        \
+    do {                                                            \
+        if (!(cond)) {                                              \
+            printf("FAIL %u: %s\n", (unsigned)(n), what);           \
+            failures++;                                             \
+        }                                                           \
+    } while (0)
+
+uint32_t sys_now(void) {
+    return now;
+}
+
+// TXE interrupts until the ring is empty
+static void drain(uint32_t max) {
+    for (uint32_t i = 0; i < max && mock_uart.txe_irq; i++) {
+        logger_irq();
+    }
+}
+
+static void event(uint32_t n) {
+    now = n * 3;
+    logger_event(n, 2, n, ~n);
+}
+
+// Records n, n + 1, ... at pos of the output, as Tools/log_decoder.py reads them
+static uint32_t check_records(uint32_t pos, uint32_t n, uint32_t count) {
+    for (uint32_t i = 0; i < count; i++, n++, pos += RECLEN) {
+        const uint8_t *rec = &mock_uart.out[pos];
+        uint32_t arg0 = rec[4] | rec[5] << 8 | rec[6] << 16 | (uint32_t)rec[7] << 24;
+        uint32_t arg1 = rec[8] | rec[9] << 8 | rec[10] << 16 | (uint32_t)rec[11] << 24;
+        if (rec[0] != (LOGGER_RECORD | 2) || rec[1] != (uint8_t)n || (rec[2] | rec[3] << 8) != (uint16_t)(n * 3)
+            || arg0 != n || arg1 != ~n) {
+            CHECK(0, n, "record intact and in order");
+            break;
+        }
+    }
+    return pos;
+}
+
+// More records than the ring holds: the ones that fit go out, the rest are counted
+static void test_full(void) {
+    const uint32_t fit = LOGGER_BUFSIZE / RECLEN;
+
+    for (uint32_t n = 0; n < fit + 20; n++) {
+        event(n);
+    }
+    CHECK(logger_dropped() == 20, logger_dropped(), "records that did not fit counted");
+
+    // 4 bytes are left: a record without arguments still fits, a line does not
+    logger_event(0xEE, 0, 0, 0);
+    logger_write("hello\n", 6);
+    CHECK(logger_dropped() == 21, logger_dropped(), "line that did not fit counted");
+
+    drain(2 * LOGGER_BUFSIZE);
+    CHECK(mock_uart.len == fit * RECLEN + 4, mock_uart.len, "bytes out");
+    uint32_t pos = check_records(0, 0, fit);
+    CHECK(mock_uart.out[pos] == LOGGER_RECORD && mock_uart.out[pos + 1] == 0xEE, pos, "last record");
+}
+
+// With the reader part way through, records wrap around the end of the ring whole
+static void test_wrap(void) {
+    const uint32_t skip = 100;
+    uint32_t drops = logger_dropped();
+
+    mock_uart.len = 0;
+    for (uint32_t n = 0; n < 50; n++) {
+        event(n);
+    }
+    drain(skip);
+    for (uint32_t n = 50; n < 50 + 80; n++) {
+        event(n);
+    }
+    drain(2 * LOGGER_BUFSIZE);
+
+    // the second lot fills what the reader had freed, not a byte more
+    uint32_t sent = mock_uart.len / RECLEN;
+    CHECK(mock_uart.len % RECLEN == 0, mock_uart.len, "whole records out");
+    CHECK(sent == (LOGGER_BUFSIZE + skip) / RECLEN, sent, "records out");
+    CHECK(logger_dropped() - drops == 130 - sent, logger_dropped(), "the others counted");
+    check_records(0, 0, sent);
+
+    char line[LOGGER_BUFSIZE + 1];
+    memset(line, 'x', sizeof(line));
+    mock_uart.len = 0;
+    logger_write(line, LOGGER_BUFSIZE + 1);
+    CHECK(logger_dropped() - drops == 131 - sent && !mock_uart.txe_irq, mock_uart.len, "longer than the ring");
+    logger_write(line, LOGGER_BUFSIZE);
+    drain(2 * LOGGER_BUFSIZE);
+    CHECK(mock_uart.len == LOGGER_BUFSIZE, mock_uart.len, "exactly the ring");
+}
+
+int main(void) {
+    logger_init();
+    test_full();
+    test_wrap();
+
+    printf("%s\n", failures ? "FAILED" : "OK");
+    return failures != 0;
+}
@@ -0,0 +1,414 @@
+// report_event() batching at the REPORT_DATA_MAX boundary: events that just fit,
+// that flush the batch first, and that cannot fit even in an empty batch. Then the
+// retransmit ring: ACKs, the resend schedule and the oldest batch making room. And
+// collector discovery: which answers are taken and when a probed collector goes.
+
+// The batch and its state are static in report.c, so it is compiled into this test
+// against the lwIP stand-ins in mock/lwip
+#include "../App/Src/report.c"
+
+#include <stdio.h>
+#include <string.h>
+
+#define TYPE 0x42
+#define IP(a, b, c, d) {(uint32_t)(d) << 24 | (c) << 16 | (b) << 8 | (a)}
+
+static const uint8_t id[3] = {0x12, 0x34, 0x56};
+static const uint8_t lengths[] = {0, 161, 162, 163, 175, 176, 177, 180, 188, 255};
+
+static uint8_t payload[255];
+static int failures = 0;
+
+#define CHECK(cond, n, what)                                        \
+    do {                                                            \
+        if (!(cond)) {                                              \
+            printf("FAIL %u: %s\n", (unsigned)(n), what);           \
+            failures++;                                             \
+        }                                                           \
+    } while (0)
+
+/*
+ * lwIP and logger stand-ins: the datagrams sent, the time, nothing else
+ */
+
+struct udp_pcb {
+    int unused;
+};
+
+const ip_addr_t ip_addr_any = {0};
+const ip_addr_t ip_addr_broadcast = {0xFFFFFFFF};
+struct netif *netif_default = NULL;
+
+static struct udp_pcb pcb;
+static uint32_t now = 1000;
+static uint32_t sent_count = 0;
+static uint16_t sent_len = 0;
+static uint8_t sent[REPORT_DATA_MAX];
+static ip_addr_t sent_to;
+static struct netif eth0 = {IP(192, 168, 1, 10), IP(255, 255, 255, 0), IP(192, 168, 1, 1)};
+
+uint32_t sys_now(void) {
+    return now;
+}
+
+struct udp_pcb *udp_new(void) {
+    return &pcb;
+}
+
+err_t udp_bind(struct udp_pcb *pcb, const ip_addr_t *ipaddr, u16_t port) {
+    return ERR_OK;
+}
+
+void udp_recv(struct udp_pcb *pcb, udp_recv_fn recv, void *recv_arg) {
+}
+
+err_t udp_sendto(struct udp_pcb *pcb, struct pbuf *p, const ip_addr_t *dst_ip, u16_t dst_port) {
+    sent_count++;
+    sent_len = p->tot_len;
+    sent_to = *dst_ip;
+    memcpy(sent, p->payload, p->tot_len <= sizeof(sent) ? p->tot_len : sizeof(sent));
+    return ERR_OK;
+}
+
+struct pbuf *pbuf_alloced_custom(pbuf_layer l, u16_t length, pbuf_type type, struct pbuf_custom *p,
+                                 void *payload_mem, u16_t payload_mem_len) {
+    if (LWIP_MEM_ALIGN_SIZE(l) + length > payload_mem_len) {
+        return NULL;
+    }
+    p->pbuf.next = NULL;
+    p->pbuf.payload = (uint8_t *)payload_mem + LWIP_MEM_ALIGN_SIZE(l);
+    p->pbuf.tot_len = length;
+    p->pbuf.len = length;
+    return &p->pbuf;
+}
+
+// Every pbuf here is custom, the last reference goes with the first free
+u8_t pbuf_free(struct pbuf *p) {
+    ((struct pbuf_custom *)p)->custom_free_function(p);
+    return 1;
+}
+
+u16_t pbuf_copy_partial(const struct pbuf *p, void *dataptr, u16_t len, u16_t offset) {
+    if (offset >= p->tot_len) {
+        return 0;
+    }
+    if (len > p->tot_len - offset) {
+        len = p->tot_len - offset;
+    }
+    memcpy(dataptr, (const uint8_t *)p->payload + offset, len);
+    return len;
+}
+
+int ipaddr_aton(const char *cp, ip_addr_t *addr) {
+    return 0; // REPORT_COLLECTOR_IP is empty
+}
+
+err_t etharp_query(struct netif *netif, const ip4_addr_t *ipaddr, struct pbuf *q) {
+    return ERR_OK;
+}
+
+u32_t lwip_ntohl(u32_t n) {
+    return __builtin_bswap32(n);
+}
+
+void logger_event(uint8_t id, uint8_t argc, uint32_t arg0, uint32_t arg1) {
+}
+
+/*
+ * Tests
+ */
+
+static void reset(void) {
+    report_batch_len = 0;
+    report_seq = 0;
+    ip_addr_set_zero(&report_collector);
+    report_source = REPORT_SRC_NONE;
+    report_unacked = 0;
+    report_netif_ip = 0;
+    netif_default = NULL;
+    memset(report_ring, 0, sizeof(report_ring));
+    memset(&report_stats, 0, sizeof(report_stats));
+    report_init(id);
+    sent_count = 0;
+    sent_len = 0;
+}
+
+static void rx_free(struct pbuf *p) {
+}
+
+// A datagram on the report port as report_recv() gets it from lwIP
+static void recv_msg(uint8_t *msg, uint16_t len, ip_addr_t from) {
+    struct pbuf_custom p = {{NULL, msg, len, len}, rx_free};
+
+    report_recv(NULL, &pcb, &p.pbuf, &from, REPORT_PORT);
+}
+
+static void recv_ack(uint16_t seq) {
+    uint8_t msg[6] = {id[0], id[1], id[2], REPORT_TYPE_ACK, seq >> 8, seq};
+
+    recv_msg(msg, sizeof(msg), (ip_addr_t)IP(192, 168, 1, 2));
+}
+
+static void recv_here(ip_addr_t from) {
+    uint8_t msg[4] = {id[0], id[1], id[2], REPORT_TYPE_HERE};
+
+    recv_msg(msg, sizeof(msg), from);
+}
+
+// The collector option of a DHCP reply, as lwIP's parser hands it over
+static void dhcp_option(uint8_t msg_type, ip_addr_t ip) {
+    uint8_t msg[9] = {53, 1, msg_type, REPORT_DHCP_OPTION, 4};
+    struct pbuf_custom p = {{NULL, msg, sizeof(msg), sizeof(msg)}, rx_free};
+
+    memcpy(&msg[5], &ip, 4);
+    report_dhcp_option(msg_type, REPORT_DHCP_OPTION, 4, &p.pbuf, 5);
+}
+
+static void send_batch(void) {
+    report_event(TYPE, payload, 1);
+    report_flush();
+}
+
+// Batches still waiting for their ACK, as a bit per sequence number from base
+static uint32_t held(uint16_t base) {
+    uint32_t seqs = 0;
+
+    for (int i = 0; i < REPORT_RING_SIZE; i++) {
+        if (report_ring[i].len != 0) {
+            seqs |= 1u << (uint16_t)(report_ring[i].seq - base);
+        }
+    }
+    return seqs;
+}
+
+// [DT hi][DT lo][type][len][payload] at pos of the last datagram
+static int sent_event(uint16_t pos, uint8_t len) {
+    return sent[pos + 2] == TYPE && sent[pos + 3] == len && memcmp(&sent[pos + 4], payload, len) == 0;
+}
+
+// The first event of a batch: it fits behind the header up to 176 bytes, longer is dropped
+static void test_empty(uint8_t len) {
+    int fits = REPORT_EVENTS_HLEN + 4 + len <= REPORT_DATA_MAX;
+
+    reset();
+    report_event(TYPE, payload, len);
+    CHECK(report_batch_len <= REPORT_DATA_MAX, len, "batch within REPORT_DATA_MAX");
+    CHECK(sent_count == 0, len, "nothing sent before the flush");
+
+    if (fits) {
+        CHECK(report_stats.events == 1 && report_stats.dropped == 0, len, "event queued");
+        CHECK(report_batch_len == REPORT_EVENTS_HLEN + 4 + len, len, "batch length");
+        report_flush();
+        CHECK(sent_count == 1 && sent_len == REPORT_EVENTS_HLEN + 4 + len, len, "flushed as one datagram");
+        CHECK(memcmp(sent, id, sizeof(id)) == 0 && sent[3] == REPORT_TYPE_EVENTS && sent[5] == 1, len,
+              "batch header");
+        CHECK(sent_event(REPORT_EVENTS_HLEN, len), len, "event in the batch");
+    } else {
+        CHECK(report_stats.events == 0 && report_stats.dropped == 1, len, "event dropped as too big");
+        CHECK(report_batch_len == 0, len, "batch left empty");
+        report_flush();
+        CHECK(sent_count == 0, len, "nothing to flush");
+    }
+}
+
+// Behind a 10-byte event: up to 162 bytes join the batch, longer flush it first
+static void test_second(uint8_t len) {
+    const uint16_t first = REPORT_EVENTS_HLEN + 4 + 10;
+
+    reset();
+    report_event(TYPE, payload, 10);
+    report_event(TYPE, payload, len);
+    CHECK(report_batch_len <= REPORT_DATA_MAX, len, "batch within REPORT_DATA_MAX");
+
+    if (first + 4 + len <= REPORT_DATA_MAX) {
+        CHECK(sent_count == 0, len, "no flush while it fits");
+        CHECK(report_batch_len == first + 4 + len && report_batch_count == 2, len, "both events queued");
+        report_flush();
+        CHECK(sent_count == 1 && sent_len == first + 4 + len, len, "flushed as one datagram");
+        CHECK(sent_event(REPORT_EVENTS_HLEN, 10) && sent_event(first, len), len, "events in order");
+        return;
+    }
+
+    CHECK(sent_count == 1 && sent_len == first, len, "first batch flushed on its own");
+    CHECK(sent[5] == 1 && sent_event(REPORT_EVENTS_HLEN, 10), len, "first event sent");
+    if (REPORT_EVENTS_HLEN + 4 + len <= REPORT_DATA_MAX) {
+        CHECK(report_batch_len == REPORT_EVENTS_HLEN + 4 + len && report_batch_count == 1, len,
+              "event starts the next batch");
+        CHECK(report_stats.dropped == 0, len, "nothing dropped");
+    } else {
+        CHECK(report_batch_len == 0 && report_stats.dropped == 1, len, "event dropped as too big");
+    }
+}
+
+// ACKs clear their own batch in any order, unknown and repeated ones change nothing
+static void test_ack(void) {
+    reset();
+    send_batch();
+    send_batch();
+    send_batch();
+    CHECK(held(0) == 0x7, 0, "three batches held");
+
+    recv_ack(7);
+    recv_ack(0xFFFF);
+    CHECK(held(0) == 0x7 && report_stats.acked == 0, 0, "unknown ACKs ignored");
+
+    recv_ack(2);
+    CHECK(held(0) == 0x3 && report_stats.acked == 1, 2, "out-of-order ACK");
+    recv_ack(0);
+    CHECK(held(0) == 0x2 && report_stats.acked == 2, 0, "ACK of the oldest");
+    recv_ack(0);
+    recv_ack(2);
+    CHECK(held(0) == 0x2 && report_stats.acked == 2, 0, "repeated ACKs ignored");
+
+    recv_ack(1);
+    CHECK(held(0) == 0 && report_stats.acked == 3 && report_stats.lost == 0, 1, "ring empty");
+}
+
+// Resent 200, 400, 800, 1600, then every 3200 ms; given up as lost after REPORT_RETRIES
+static void test_backoff(void) {
+    static const uint32_t resends[REPORT_RETRIES] = {200, 600, 1400, 3000, 6200, 9400};
+    const uint32_t t0 = now;
+    unsigned n = 0;
+
+    reset();
+    send_batch();
+    for (uint32_t t = t0; t <= t0 + 20000; t++) {
+        uint32_t before = sent_count;
+        now = t;
+        report_poll();
+        if (sent_count != before) {
+            CHECK(n < REPORT_RETRIES && t - t0 == resends[n], t - t0, "resend time");
+            n++;
+        }
+        if (report_stats.lost != 0) {
+            CHECK(t - t0 == 9400 + REPORT_RETRY_MAX_MS, t - t0, "given up one wait after the last try");
+            break;
+        }
+    }
+    CHECK(n == REPORT_RETRIES && report_stats.retries == REPORT_RETRIES, n, "resends");
+    CHECK(report_stats.lost == 1 && held(0) == 0, n, "batch lost and its slot free");
+    CHECK(sent_count == 1 + REPORT_RETRIES, n, "nothing sent after giving up");
+}
+
+// A full ring drops the oldest batch, across the sequence number wrap too
+static void test_evict(uint16_t seq) {
+    reset();
+    report_seq = seq;
+    for (int i = 0; i < REPORT_RING_SIZE; i++) {
+        send_batch();
+    }
+    CHECK(held(seq) == (1u << REPORT_RING_SIZE) - 1 && report_stats.lost == 0, seq, "ring full");
+
+    send_batch();
+    CHECK(held(seq) == ((1u << REPORT_RING_SIZE) - 1) << 1, seq, "oldest batch dropped");
+    CHECK(report_stats.lost == 1, seq, "drop counted as lost");
+
+    recv_ack(seq);
+    CHECK(report_stats.acked == 0, seq, "ACK of the dropped batch ignored");
+}
+
+static int is_probe(void) {
+    return sent_len == 4 && sent[3] == REPORT_TYPE_PROBE && ip_addr_cmp(&sent_to, IP_ADDR_BROADCAST);
+}
+
+// HERE counts only within REPORT_PROBE_WAIT_MS of a probe, the DHCP option only in an ACK
+static void test_discover(void) {
+    const ip_addr_t here = IP(192, 168, 1, 2), other = IP(192, 168, 1, 66), dhcp = IP(10, 0, 0, 5);
+
+    reset();
+    recv_here(other);
+    CHECK(report_source == REPORT_SRC_NONE, 0, "HERE without a probe ignored");
+
+    netif_default = &eth0;
+    report_poll();
+    CHECK(sent_count == 1 && is_probe(), sent_count, "probe once there is an address");
+    now += REPORT_PROBE_WAIT_MS;
+    recv_here(other);
+    CHECK(report_source == REPORT_SRC_NONE, 0, "late HERE ignored");
+
+    now += REPORT_PROBE_MS - REPORT_PROBE_WAIT_MS;
+    report_poll();
+    CHECK(sent_count == 2 && is_probe(), sent_count, "probe again");
+    now += 10;
+    recv_here(here);
+    CHECK(report_source == REPORT_SRC_PROBE && ip_addr_cmp(&report_collector, &here), 0, "HERE taken");
+    send_batch();
+    CHECK(ip_addr_cmp(&sent_to, &here), 0, "batch to the collector");
+
+    dhcp_option(DHCP_OFFER, dhcp);
+    dhcp_option(0, dhcp);
+    CHECK(report_source == REPORT_SRC_PROBE, 0, "DHCP option outside an ACK ignored");
+    dhcp_option(DHCP_ACK, dhcp);
+    CHECK(report_source == REPORT_SRC_DHCP && ip_addr_cmp(&report_collector, &dhcp), 0, "DHCP ACK taken");
+
+    eth0.ip_addr = (ip_addr_t)IP(192, 168, 1, 11);
+    report_poll();
+    CHECK(report_source == REPORT_SRC_DHCP, 0, "DHCP collector kept over a new lease");
+    eth0.ip_addr = (ip_addr_t)IP(192, 168, 1, 10);
+}
+
+// A probed collector goes with the address or after REPORT_PROBE_LOST batches given up
+static void test_forget(void) {
+    const ip_addr_t here = IP(192, 168, 1, 2);
+
+    reset();
+    netif_default = &eth0;
+    report_poll();
+    recv_here(here);
+    CHECK(report_source == REPORT_SRC_PROBE, 0, "collector found");
+
+    eth0.ip_addr = (ip_addr_t)IP(0, 0, 0, 0);
+    report_poll();
+    CHECK(report_source == REPORT_SRC_NONE, 0, "forgotten with the lease");
+    eth0.ip_addr = (ip_addr_t)IP(192, 168, 1, 10);
+    sent_count = 0;
+    report_poll();
+    CHECK(sent_count == 1 && is_probe(), sent_count, "probe with the new lease");
+    recv_here(here);
+    CHECK(report_source == REPORT_SRC_PROBE, 0, "collector found again");
+
+    // one batch given up, one ACKed, then the next ones given up
+    send_batch();
+    for (int i = 0; i < 20000 && report_stats.lost == 0; i++, now++) {
+        report_poll();
+    }
+    send_batch();
+    recv_ack(report_seq - 1);
+    send_batch();
+    for (int i = 0; i < 20000 && report_stats.lost == 1; i++, now++) {
+        report_poll();
+    }
+    CHECK(report_stats.lost == 2 && report_source == REPORT_SRC_PROBE, report_stats.lost,
+          "an ACK in between keeps the collector");
+
+    send_batch();
+    for (int i = 0; i < 20000 && report_source == REPORT_SRC_PROBE; i++, now++) {
+        report_poll();
+    }
+    CHECK(report_stats.lost == 3 && report_source == REPORT_SRC_NONE, report_stats.lost,
+          "forgotten after batches given up in a row");
+    sent_count = 0;
+    report_poll();
+    CHECK(sent_count == 1 && is_probe(), sent_count, "probe right away");
+}
+
+int main(void) {
+    for (unsigned i = 0; i < sizeof(payload); i++) {
+        payload[i] = (uint8_t)(i * 7 + 3);
+    }
+
+    for (unsigned i = 0; i < sizeof(lengths) / sizeof(lengths[0]); i++) {
+        test_empty(lengths[i]);
+        test_second(lengths[i]);
+    }
+
+    test_ack();
+    test_backoff();
+    test_evict(0);
+    test_evict(0xFFFE);
+    test_discover();
+    test_forget();
+
+    printf("%s\n", failures ? "FAILED" : "OK");
+    return failures != 0;
+}
@@ -0,0 +1,107 @@
+import re
+import struct
+import sys
+
+'''
+Log stream format (USART1, 115200 8N1):
+- TEXT:
+    + plain ASCII lines from LOG_ERROR/LOG_WARN/LOG_INFO/LOG_DEBUG
+- EVENT:
+    + binary record from LOG_EVENT0/1/2, first byte is never ASCII
+    + [0xA0 | ARGC][ID][MS0][MS1][ARG0 x 4]...
+    + MS: 16-bit milliseconds since boot (wraps every 65.536 s)
+    + ARG: 32-bit, all fields are little-endian
+
+Usage:
+    stty -F /dev/ttyUSB0 115200 raw
+    python3 log_decoder.py /dev/ttyUSB0
+'''
+
+RECORD = 0xA0
+RECORD_MASK = 0xF0
+RECORD_ARGS = 2
+
+# must match LOG_EV_* in App/Inc/logger.h
+EVENTS = {
+    0x01: "BOOT",
+    0x02: "MAC = %06lX%06lX",
+    0x03: "ID1 = 0x%04lX, ID2 = 0x%04lX",
+    0x04: "REV = 0x%02lX",
+    0x05: "lwIP assertion failed at line %lu",
+    0x10: "udp_sendto err: %ld",
+    0x11: "udp_new failed",
+    0x12: "no free report buffer",
+    0x13: "collector = %08lX from %lu",
+    0x14: "report %lu lost after %lu tries",
+    0x15: "REPORT = %lu retries, %lu lost",
+    0x16: "report pbuf for %lu bytes failed",
+    0x17: "event %lu of %lu bytes too big",
+    0x20: "SNDUID %08lX (%lu bytes)",
+    0x21: "SNDALV",
+    0x22: "CLRUID",
+    0x23: "SNDUID batch of %lu",
+    0x24: "card %08lX took %lu ms",
+    0x30: "SPI = %lu/frame",
+    0x31: "LOG dropped = %lu writes",
+    0x32: "CSUM Tx = hw %lu / sw %lu cycles/frame",
+    0x33: "RFID = %lu sweeps/s, %lu tags/s",
+    0x34: "RFID = field %lu%%, SPI %lu/s",
+    0x35: "card = %lu ms avg, %lu ms max",
+    0x36: "HEAP = %lu used, %lu peak",
+    0x37: "lwIP heap = %lu peak of %lu",
+    0x38: "PBUF_POOL = %lu peak of %lu",
+    0x39: "CSUM Rx = hw %lu / sw %lu cycles/frame",
+}
+
+CONVERSION = re.compile(r'%[-+ #0]*\d*(?:\.\d+)?l?([diuxXc%])')
+
+
+def format_event(fmt, args):
+    # printf signed conversions take the 32-bit value as two's complement
+    values = []
+    for conv, arg in zip([c for c in CONVERSION.findall(fmt) if c != '%'], args):
+        if conv in 'di' and arg & 0x80000000:
+            arg -= 1 << 32
+        values.append(arg)
+    return fmt % tuple(values)
+
+
+def decode(stream, out=sys.stdout):
+    text = bytearray()
+    while True:
+        lead = stream.read(1)
+        if not lead:
+            break
+        lead = lead[0]
+
+        if lead & RECORD_MASK != RECORD or lead & 0x0F > RECORD_ARGS:
+            # plain text, flush it line by line
+            text.append(lead)
+            if lead == ord('\n'):
+                out.write(text.decode('ascii', 'replace'))
+                out.flush()
+                text.clear()
+            continue
+
+        argc = lead & 0x0F
+        body = stream.read(3 + 4 * argc)
+        if len(body) < 3 + 4 * argc:
+            break
+        event = body[0]
+        ms = struct.unpack_from('<H', body, 1)[0]
+        args = struct.unpack_from('<%dI' % argc, body, 3)
+
+        if event in EVENTS:
+            line = format_event(EVENTS[event], args)
+        else:
+            line = "event 0x%02X %s" % (event, ' '.join('0x%08X' % a for a in args))
+        out.write("[%5u.%03u] %s\n" % (ms // 1000, ms % 1000, line))
+        out.flush()
+
+
+if __name__ == "__main__":
+    if len(sys.argv) > 1:
+        with open(sys.argv[1], 'rb', buffering=0) as stream:
+            decode(stream)
+    else:
+        decode(sys.stdin.buffer)
@@ -0,0 +1,97 @@
+import os
+import re
+import sys
+
+'''
+RAM budget of the firmware, read from the linker map:
+- RAM: .data, .bss and the heap/stack reserve of ._user_heap_stack
+- per group: lwIP, App files, Core/Drivers, C library
+- fails when the total leaves less than RESERVE bytes of the 20 KB free,
+  the linker only fails when RAM is exceeded
+
+Usage:
+    python3 ram_budget.py build/Debug/f103c8tx_ether_rfid.map [reserve]
+'''
+
+RAM_START = 0x20000000
+RAM_SIZE = 20 * 1024
+RESERVE = 1024  # stack deeper than _Min_Stack_Size, newlib heap beyond _Min_Heap_Size
+
+OUTPUT = re.compile(r'^(\.data|\.bss|\._user_heap_stack)(?:\s+(0x[0-9a-f]+)\s+(0x[0-9a-f]+))?')
+OUTPUT_CONT = re.compile(r'^\s+(0x[0-9a-f]+)\s+(0x[0-9a-f]+)\s*$')
+INPUT = re.compile(r'^ (\.data\S*|\.bss\S*|COMMON)(?:\s+(0x[0-9a-f]+)\s+(0x[0-9a-f]+)\s+(\S.*))?$')
+INPUT_CONT = re.compile(r'^\s+(0x[0-9a-f]+)\s+(0x[0-9a-f]+)\s+(\S.*)$')
+
+
+def group(path):
+    name = path.replace('\\', '/')
+    if '/LwIP/' in name or 'lwipcore' in name:
+        return 'lwIP'
+    if '/App/' in name:
+        return 'App ' + os.path.basename(name).split('.')[0]
+    if '.a(' in name:
+        return 'C library'
+    return 'Core/Drivers'
+
+
+def parse(lines):
+    sections = {}
+    groups = {}
+    pending = None
+    pending_out = None
+    for line in lines:
+        if pending_out:
+            m = OUTPUT_CONT.match(line)
+            if m:
+                sections[pending_out] = int(m.group(2), 16)
+            pending_out = None
+            continue
+        m = OUTPUT.match(line)
+        if m:
+            if m.group(2) is None:
+                pending_out = m.group(1)
+            else:
+                sections[m.group(1)] = int(m.group(3), 16)
+            continue
+        m = INPUT.match(line)
+        if m:
+            if m.group(2) is None:
+                pending = m.group(1)  # long name, address and size on the next line
+                continue
+            addr, size, path = int(m.group(2), 16), int(m.group(3), 16), m.group(4)
+        elif pending:
+            m = INPUT_CONT.match(line)
+            pending = None
+            if not m:
+                continue
+            addr, size, path = int(m.group(1), 16), int(m.group(2), 16), m.group(3)
+        else:
+            continue
+        if size and RAM_START <= addr < RAM_START + RAM_SIZE:
+            groups[group(path)] = groups.get(group(path), 0) + size
+    return sections, groups
+
+
+def main():
+    if len(sys.argv) < 2:
+        print("usage: ram_budget.py MAP [reserve]")
+        return 2
+    reserve = int(sys.argv[2], 0) if len(sys.argv) > 2 else RESERVE
+    with open(sys.argv[1]) as f:
+        sections, groups = parse(f)
+
+    total = sum(sections.values())
+    for name, size in sorted(groups.items(), key=lambda g: -g[1]):
+        print(f"  {name:<24} {size:6d}")
+    for name in ('.data', '.bss', '._user_heap_stack'):
+        print(f"{name:<26} {sections.get(name, 0):6d}")
+    print(f"{'RAM':<26} {total:6d} of {RAM_SIZE}, {RAM_SIZE - total} free, {reserve} reserved")
+
+    if total + reserve > RAM_SIZE:
+        print(f"RAM budget exceeded by {total + reserve - RAM_SIZE} bytes")
+        return 1
+    return 0
+
+
+if __name__ == "__main__":
+    sys.exit(main())
@@ -1,4 +1,5 @@
 import socket
+from collections import deque
 
 '''
 Message format:
@@ -8,8 +9,100 @@ Message format:
 - CARD_UID:
     + when card is detected
     + 8 bytes: [ID0][ID1][ID2][0x01][UID0][UID1][UID2][UID3]
+- CARD_UID_LONG:
+    + when a card with a 7 or 10-byte UID is detected
+    + 5 + LEN bytes: [ID0][ID1][ID2][0x02][LEN][UID0]...[UIDn]
+- CARD_UID_BATCH:
+    + when an inventory sweep finds several cards
+    + [ID0][ID1][ID2][0x03][N] then N times [LEN][UID0]...[UIDn]
+- CARD_DATA:
+    + when READER_READ_SECTOR or READER_NTAG_PAGES is set, one message per card
+    + [ID0][ID1][ID2][0x04][LEN][UID0]...[UIDn][N] then N blocks of 16 bytes
+    + MIFARE Classic: the sector blocks, N = 0 when no key opened the sector
+    + NTAG21x / Ultralight EV1: user pages from page 4, 4 pages per block
+    + N = 0 for any other card
+- EVENTS (REPORT_BATCH):
+    + the messages above queued on the reader and sent together
+    + [ID0][ID1][ID2][0x05][VER][N][SEQ x 2][T0 x 4] then N times [DT x 2][TYPE][LEN][PAYLOAD]
+    + SEQ: batch number since boot, T0: ms since boot of the first event, DT: ms after T0, big-endian
+    + VER 2, PAYLOAD is what a single message of TYPE carries after its type byte
+    + VER 1 has no SEQ and is not acknowledged
+    + this server answers ACK to the sender: [ID0][ID1][ID2][0x85][SEQ x 2]
+    + the reader sends a batch again until its ACK comes back, after 0.2, 0.4, ... 3.2 seconds,
+      so a batch seen before (same SEQ and T0) is acknowledged again but not printed
+- PROBE:
+    + broadcast every 5 seconds while the reader does not know its collector
+    + 4 bytes: [ID0][ID1][ID2][0x06]
+    + this server answers HERE to the sender: [ID0][ID1][ID2][0x86], the reader takes it
+      within 1 second of its probe
+    + the reader then sends unicast to this server, and probes again when it gets a new
+      address or two batches in a row go unacknowledged
 '''
 
+EVENTS_VERSION = 2
+TYPE_EVENTS = 0x05
+TYPE_PROBE = 0x06
+TYPE_ACK = 0x85
+TYPE_HERE = 0x86
+SEEN_BATCHES = 64 # per reader, more than the reader keeps in flight
+
+seen = {}
+
+def is_duplicate(reader, seq, t0):
+    batches = seen.setdefault(reader, deque(maxlen=SEEN_BATCHES))
+    if (seq, t0) in batches:
+        return True
+    batches.append((seq, t0))
+    return False
+
+def print_message(reader, type, payload):
+    if type == 0x00 and payload == b'\xff\xff\xff\xff':
+        print(f"{reader} Alive")
+    elif type == 0x01:
+        print(f"{reader} Card ID: {payload.hex()}")
+    elif type == 0x02 and len(payload) >= 1 and len(payload) == 1 + payload[0]:
+        print(f"{reader} Card ID: {payload[1:].hex()}")
+    elif type == 0x03 and len(payload) >= 1:
+        count, pos = payload[0], 1
+        for _ in range(count):
+            if pos >= len(payload) or pos + 1 + payload[pos] > len(payload):
+                print(f"{reader} Truncated batch")
+                break
+            print(f"{reader} Card ID: {payload[pos + 1:pos + 1 + payload[pos]].hex()}")
+            pos += 1 + payload[pos]
+    elif type == 0x04 and len(payload) >= 2 and len(payload) >= 2 + payload[0]:
+        uid = payload[1:1 + payload[0]]
+        blocks = payload[1 + payload[0]]
+        data = payload[2 + payload[0]:]
+        if len(data) != 16 * blocks:
+            print(f"{reader} Truncated card data")
+            return
+        print(f"{reader} Card ID: {uid.hex()}")
+        for i in range(blocks):
+            print(f"{reader}   block {i}: {data[16 * i:16 * (i + 1)].hex()}")
+    elif type == 0x05 and len(payload) >= 6 and payload[0] == 1:
+        print_events(reader, payload[1], int.from_bytes(payload[2:6], 'big'), payload[6:])
+    elif type == 0x05 and len(payload) >= 8:
+        if payload[0] != EVENTS_VERSION:
+            print(f"{reader} Unknown events version: {payload[0]}")
+            return
+        print_events(reader, payload[1], int.from_bytes(payload[4:8], 'big'), payload[8:])
+    else:
+        print(f"{reader} Unknown type: {type}")
+
+
+def print_events(reader, count, t0, payload):
+    pos = 0
+    for _ in range(count):
+        if pos + 4 > len(payload) or pos + 4 + payload[pos + 3] > len(payload):
+            print(f"{reader} Truncated events")
+            break
+        dt = int.from_bytes(payload[pos:pos + 2], 'big')
+        event_type, length = payload[pos + 2], payload[pos + 3]
+        print_message(f"{reader} [{(t0 + dt) / 1000:.3f}]", event_type, payload[pos + 4:pos + 4 + length])
+        pos += 4 + length
+
+
 def start_udp_server(host='0.0.0.0', port=12345):
     with socket.socket(socket.AF_INET, socket.SOCK_DGRAM) as server_socket:
         server_socket.setsockopt(socket.SOL_SOCKET, socket.SO_BROADCAST, 1)
@@ -20,15 +113,19 @@ def start_udp_server(host='0.0.0.0', port=12345):
         while True:
             message, client_address = server_socket.recvfrom(1024)
             print(f"Received {len(message)} bytes: {message.hex()}")
-            reader = message[0:3]
-            type = message[3]
-            payload = message[4:]
-            if type == 0x00 and payload == b'\xff\xff\xff\xff':
-                print(f"{reader.hex()} Alive")
-            elif type == 0x01:
-                print(f"{reader.hex()} Card ID: {payload.hex()}")
-            else:
-                print(f"{reader.hex()} Unknown type: {type}")
+            if len(message) < 4:
+                continue
+            if message[3] == TYPE_PROBE:
+                print(f"{message[0:3].hex()} Probe from {client_address[0]}")
+                server_socket.sendto(message[0:3] + bytes([TYPE_HERE]), client_address)
+                continue
+            if message[3] == TYPE_EVENTS and len(message) >= 12 and message[4] == EVENTS_VERSION:
+                seq = message[6:8]
+                server_socket.sendto(message[0:3] + bytes([TYPE_ACK]) + seq, client_address)
+                if is_duplicate(message[0:3], seq, message[8:12]):
+                    print(f"{message[0:3].hex()} Duplicate batch {int.from_bytes(seq, 'big')}")
+                    continue
+            print_message(message[0:3].hex(), message[3], message[4:])
 
 
 if __name__ == "__main__":